@@ -6,45 +6,40 @@
  */
 
 #include "InfinityGameLogic.hpp"
+#include "smlnd_trace.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <sstream>
 
 namespace smlnd {
 
 
-GameCell::GameCell(const int x, const int y, const std::string s_glyph) {
+GameCell::GameCell(const int x, const int y, const Glyph glyph) {
 
-  this->x = x;
-  this->y = y;
+  this->x = static_cast<int16_t>(x);
+  this->y = static_cast<int16_t>(y);
 
   auto getGlyphEdges = [&](const Glyph glyph) {
-    if (glyph == SBAR) return (&E_SBAR);
-    if (glyph == SARC) return (&E_SARC);
-    if (glyph == DARC) return (&E_DARC);
-    if (glyph == TRIO) return (&E_TRIO);
-    if (glyph == LEND) return (&E_LEND);
-    if (glyph == QUAD) return (&E_QUAD);
-    return (&E_BLNK);
+    if (glyph == SBAR) return (E_SBAR);
+    if (glyph == SARC) return (E_SARC);
+    if (glyph == DARC) return (E_DARC);
+    if (glyph == TRIO) return (E_TRIO);
+    if (glyph == LEND) return (E_LEND);
+    if (glyph == QUAD) return (E_QUAD);
+    return (E_BLNK);
   };
 
-  auto getGlyphType = [&](const std::string& glyphName) {
-    if (glyphName == "SBAR") return (Glyph::SBAR);
-    if (glyphName == "SARC") return (Glyph::SARC);
-    if (glyphName == "DARC") return (Glyph::DARC);
-    if (glyphName == "TRIO") return (Glyph::TRIO);
-    if (glyphName == "LEND") return (Glyph::LEND);
-    if (glyphName == "QUAD") return (Glyph::QUAD);
-    return (Glyph::BLNK);
-  };
+  this->glyph = glyph;
+  this->quarters = static_cast<uint8_t>(rand() % INF_EDGES);
 
-  this->glyph = getGlyphType(s_glyph);
-  this->curAngle = (rand() % INF_EDGES) * INF_ANGLEOFFSET;
-  this->targetAngle = this->curAngle;
-  this->edges = (short*) *getGlyphEdges(this->glyph);
+  const short* edges = getGlyphEdges(this->glyph);
+  for (short i = 0; i < INF_EDGES; i++) {
+    if (edges[i] != -1) this->connectors |= edgeBit(static_cast<Edge>(edges[i]));
+  }
+  this->connectors = rotateConnectors(this->connectors, this->quarters);
 }
 
-GameCell::~GameCell(){}
-
 
 void GameCell::rotate() {
 
@@ -52,88 +47,170 @@ void GameCell::rotate() {
   if (this->animating || this->glyph == BLNK) return;
 
   // Rotate tile to new target position.
-  targetAngle = curAngle + INF_ANGLEOFFSET;
+  quarters = (quarters + 1) % INF_EDGES;
+  connectors = rotateConnectors(connectors, 1);
+  progress = 0.0f;
   animating = true;
 }
 
 
 /**
  * Update the tiles based on any remaining move actions.
- * Only animate if animating and time-slice since last update
- * is less than Desired animation speed.
+ * A turn lasts INF_TURNTIME seconds however many frames it is drawn in, and ends exactly on
+ * the new quarter.
  */
 void GameCell::update(float fElaspedTime) {
 
   if (!animating || this->glyph == BLNK) return;
 
-  // Update last updated value.
-  this->lastUpdated += fElaspedTime;
+  this->progress += fElaspedTime / INF_TURNTIME;
+  if (this->progress >= 1.0f) {
+    this->progress = 1.0f;
+    animating = false;
+  }
+}
+
 
-  // Conditional time-slice update to tile rotation.
-  if (this->lastUpdated >= INF_ANIMATIONSPEED) {
+float GameCell::getCellRotation() const {
+  if (!this->animating) return (static_cast<float>(this->quarters * INF_ANGLEOFFSET));
 
-    this->lastUpdated = 0.0f;
+  // Part way from the quarter before.
+  int from = (this->quarters + INF_EDGES - 1) % INF_EDGES;
+  return ((from + this->progress) * INF_ANGLEOFFSET);
+}
 
-    if (curAngle != targetAngle) {
-      curAngle += INF_ANGLEDELTA;
-    } else {
-      animating = false;
-    }
+
+int GameCell::getCellStep(const int stepsPerQuarter) const {
+  if (!this->animating) return (this->quarters * stepsPerQuarter);
+
+  int from = (this->quarters + INF_EDGES - 1) % INF_EDGES;
+  int step = from * stepsPerQuarter + static_cast<int>(this->progress * stepsPerQuarter + 0.5f);
+  return (step % (INF_EDGES * stepsPerQuarter));
+}
+
+
+void ConnectorRows::resize(const int cols, const int rows) {
+  this->rows = rows;
+  this->words = cols / 64 + 1;
+  this->planes.assign(static_cast<size_t>(INF_EDGES) * rows * this->words, 0);
+}
+
+
+void ConnectorRows::set(const int x, const int y, const uint8_t connectors) {
+  const size_t plane = static_cast<size_t>(this->rows) * this->words;
+  size_t word = static_cast<size_t>(y) * this->words + x / 64;
+  uint64_t bit = uint64_t(1) << (x % 64);
+  for (int d = 0; d < INF_EDGES; d++, word += plane) {
+    if (connectors & (1 << d)) this->planes[word] |= bit;
+    else this->planes[word] &= ~bit;
   }
 }
 
 
-bool GameCell::matchEdge(const short edgeAngle) {
+/**
+ * True when every connector meets one on the neighbouring cell: each row's east plane shifted one
+ * column equals its west plane, each row's south plane equals the next row's north plane, and nothing
+ * leads off the board. Bit "cols" of the east plane is the last column's east edge, compared with the
+ * always clear padding of the west plane.
+ */
+bool ConnectorRows::isClosed() const {
 
-  // Some guard checks.
-  if (this->animating || this->glyph == BLNK) return (false);
+  if (this->rows == 0) return (true);
 
-  for (short i = 0; i < INF_EDGES; i++) {
-    if (this->edges[i] == -1) continue;  // skip blank edges...
-    int ta = ((this->edges[i] + static_cast<int>(this->curAngle))) % 360;
-    if (ta == edgeAngle) return (true);
+  const size_t plane = static_cast<size_t>(this->rows) * this->words;
+  const uint64_t* n = this->planes.data();
+  const uint64_t* e = n + plane;
+  const uint64_t* s = e + plane;
+  const uint64_t* w = s + plane;
+  const size_t last = static_cast<size_t>(this->rows - 1) * this->words;
+
+  uint64_t open = 0;
+  for (int i = 0; i < this->words; i++)
+    open |= n[i] | s[last + i];
+
+  for (int y = 0; y < this->rows && open == 0; y++) {
+    const size_t row = static_cast<size_t>(y) * this->words;
+
+    uint64_t carry = 0;
+    for (int i = 0; i < this->words; i++) {
+      open |= ((e[row + i] << 1) | carry) ^ w[row + i];
+      carry = e[row + i] >> 63;
+    }
+
+    if (y < this->rows - 1) {
+      for (int i = 0; i < this->words; i++)
+        open |= s[row + i] ^ n[row + this->words + i];
+    }
   }
+  return (open == 0);
+}
 
-  // Default is no match
-  return (false);
+
+PackedLevel::PackedLevel(const std::string spriteName, const int cols, const int rows) {
+  this->spriteName = spriteName;
+  this->cols = std::max(cols, 0);
+  this->rows = std::max(rows, 0);
+  this->glyphs.assign((size() + CELLS_PER_WORD - 1) / CELLS_PER_WORD, ~uint64_t(0) >> 1);
 }
 
 
-Level::Level(const int id, const std::string name, const char* layout) {
-  this->id = id;
-  this->name = name;
+PackedLevel::PackedLevel(const std::string spriteName, const int cols, const int rows, const uint64_t* words) :
+    PackedLevel(spriteName, cols, rows) {
+  std::copy(words, words + this->glyphs.size(), this->glyphs.begin());
+}
+
+
+PackedLevel PackedLevel::parse(const std::string& layout) {
+
+  auto getGlyphType = [&](const std::string& glyphName) {
+    if (glyphName == "SBAR") return (Glyph::SBAR);
+    if (glyphName == "SARC") return (Glyph::SARC);
+    if (glyphName == "DARC") return (Glyph::DARC);
+    if (glyphName == "TRIO") return (Glyph::TRIO);
+    if (glyphName == "LEND") return (Glyph::LEND);
+    if (glyphName == "QUAD") return (Glyph::QUAD);
+    return (Glyph::BLNK);
+  };
 
-  // Process layout to build cells.
   std::istringstream data(layout);
+  std::string spriteName;
+  int cols = 0, rows = 0;
+  data >> spriteName >> cols >> rows;
+
+  PackedLevel packed(spriteName, cols, rows);
+  std::string s_glyph;
+  for (int i = 0; i < packed.size() && data >> s_glyph; i++)
+    packed.setGlyph(i, getGlyphType(s_glyph));
+  return (packed);
+}
 
-  data >> this->spriteName;
-  data >> this->gridCols;
-  data >> this->gridRows;
 
-  int size = this->gridCols * this->gridRows;
+Level::Level(const int id, const std::string name, const PackedLevel& layout, Arena& arena) :
+    cells(ArenaAllocator<GameCell>(arena)), animatingCells(ArenaAllocator<int>(arena)),
+    settledCells(ArenaAllocator<int>(arena)) {
+  SMLND_TRACE_SCOPE("Level::Level");
+  this->id = id;
+  this->name = name;
 
-  for (int i = 0; i < size && !data.eof(); i++) {
-    std::string s_glyph;
+  this->spriteName = layout.spriteName;
+  this->spriteId = layout.spriteId;
+  this->gridCols = layout.cols;
+  this->gridRows = layout.rows;
+  this->cells.resize(this->gridCols, this->gridRows);
 
-    data >> s_glyph;
-    int x = i%this->gridCols;
-    int y = i/this->gridCols;
+  for (int i = 0; i < this->cells.size(); i++)
+    this->cells[i] = GameCell(i % this->gridCols, i / this->gridCols, layout.getGlyph(i));
 
-    GameCell* cell = new GameCell(x, y, s_glyph);
-    this->cells.emplace(std::pair<int, int>(x, y), cell);
-  }
+  this->unmatched = countUnmatched();
 }
 
 
 Level::~Level() {
   SMLND_DBG_LOG("Level deconstructor called");
-  for (auto& x : this->cells)
-    delete x.second;
-  this->cells.clear();
 }
 
 
-std::map<std::pair<int, int>, GameCell*>& Level::getGameCells() {
+CellGrid& Level::getGameCells() {
   return (cells);
 }
 
@@ -142,81 +219,191 @@ void Level::rotateTile(int x, int y) {
 
   if (this->complete) return;
 
-  if (x >= 0 && x < this->gridCols && y >= 0 && y < this->gridRows) {
-    GameCell* cell = this->cells[std::pair<int, int>(x, y)];
-    if (cell != nullptr) cell->rotate();
+  if (this->cells.contains(x, y)) {
+    GameCell& cell = this->cells.at(x, y);
+    bool wasAnimating = cell.isAnimating();
+    uint8_t before = cell.getConnectors();
+    cell.rotate();
+    connectorsChanged(cell, before);
+    if (!wasAnimating && cell.isAnimating()) this->animatingCells.push_back(y * this->gridCols + x);
   }
 }
 
 
+/**
+ * Unmatched pairs on the four sides of a cell if it had the given connectors, with its neighbours as
+ * they are.
+ */
+int Level::unmatchedAround(const int x, const int y, const uint8_t connectors) const {
+  static const int dx[INF_EDGES] = { 0, 1, 0, -1 }, dy[INF_EDGES] = { -1, 0, 1, 0 };
+
+  int count = 0;
+  for (int d = 0; d < INF_EDGES; d++) {
+    int nx = x + dx[d], ny = y + dy[d];
+    uint8_t facing = this->cells.contains(nx, ny) ? this->cells.at(nx, ny).getConnectors() : 0;
+    count += ((connectors >> d) & 1) != ((facing >> ((d + 2) % INF_EDGES)) & 1);
+  }
+  return (count);
+}
+
+
+/**
+ * Counts the unmatched pairs over the whole board: each cell's east and south sides, plus the
+ * west and north border.
+ */
+int Level::countUnmatched() const {
+  int count = 0;
+  for (const GameCell& cell : this->cells) {
+    uint8_t connectors = cell.getConnectors();
+    uint8_t east = (cell.x + 1 < this->gridCols) ? this->cells.at(cell.x + 1, cell.y).getConnectors() : 0;
+    uint8_t south = (cell.y + 1 < this->gridRows) ? this->cells.at(cell.x, cell.y + 1).getConnectors() : 0;
+    count += ((connectors & C_E) != 0) != ((east & C_W) != 0);
+    count += ((connectors & C_S) != 0) != ((south & C_N) != 0);
+    if (cell.x == 0) count += (connectors & C_W) != 0;
+    if (cell.y == 0) count += (connectors & C_N) != 0;
+  }
+  return (count);
+}
+
+
+/**
+ * Brings the unmatched count up to date after a cell's connectors changed.
+ */
+void Level::connectorsChanged(const GameCell& cell, const uint8_t before) {
+  uint8_t after = cell.getConnectors();
+  if (after == before) return;
+
+  this->unmatched += unmatchedAround(cell.x, cell.y, after) - unmatchedAround(cell.x, cell.y, before);
+}
+
+
+void Level::fillConnectorRows(ConnectorRows& rows) const {
+  rows.resize(this->gridCols, this->gridRows);
+  for (const GameCell& cell : this->cells)
+    rows.set(cell.x, cell.y, cell.getConnectors());
+}
+
+
+/**
+ * Advances every animating tile. Returns true while any tile is still animating, i.e. the level
+ * needs more updates (and frames) to settle.
+ * Only the animating cells are visited. Those that stop move to the settled list until the next
+ * update, so the renderer sees their final step.
+ */
 bool Level::update(const float fElaspedTime) {
 
-  if (this->complete) return (true);
-  for (auto& x: this->cells) x.second->update(fElaspedTime);
-  return (true);
+  this->settledCells.clear();
+  if (this->complete) return (false);
+
+  size_t kept = 0;
+  for (int index : this->animatingCells) {
+    GameCell& cell = this->cells[index];
+    cell.update(fElaspedTime);
+
+    // A tile connects again once it settles.
+    if (cell.isAnimating()) {
+      this->animatingCells[kept++] = index;
+    } else {
+      connectorsChanged(cell, 0);
+      this->settledCells.push_back(index);
+    }
+  }
+  this->animatingCells.resize(kept);
+  return (kept > 0);
 }
 
 
 /**
- * This method will check with adjacent edges and confirm if all edges are aligned
- * with partner edges. This function will return false at the earliest opportunity.
+ * This method will confirm if all edges are aligned with partner edges, i.e. no pair is
+ * left unmatched.
  */
 bool Level::isComplete() {
 
   if (this->complete) return (true);
 
-  for (unsigned short x = 0; x < this->gridCols; x++) {
-    for (unsigned short y = 0; y < this->gridRows; y++) {
+#ifdef INF_CHECK_COMPLETE
+  int counted = countUnmatched();
+  Arena scratch;
+  ConnectorRows rows(scratch);
+  fillConnectorRows(rows);
+  bool closed = rows.isClosed(), scanned = scanComplete();
+  if (counted != this->unmatched || closed != (counted == 0) || scanned != closed) {
+    SMLND_ERR_LOG("Level::isComplete: " << this->unmatched << " unmatched pairs tracked, " << counted
+        << " counted, rows closed " << closed << ", scan complete " << scanned);
+    abort();
+  }
+#endif
 
-      std::pair<int, int> indx(x, y);
+  this->complete = (this->unmatched == 0);
+  return (this->complete);
+}
 
-      GameCell* cell = this->cells[std::pair<int, int>(x, y)];
-      if (cell == nullptr) return (false);
 
-      if (cell->matchEdge(Edge::N)) {
+/**
+ * The same check as isComplete() made cell by cell, without touching the cached result. This
+ * function will return false at the earliest opportunity.
+ */
+bool Level::scanComplete() {
+
+  // Row by row, in memory order. Neighbours are one cell or one row away.
+  const int cols = this->gridCols;
+  for (int y = 0; y < this->gridRows; y++) {
+    GameCell* row = &this->cells.at(0, y);
+    for (int x = 0; x < cols; x++) {
+
+      GameCell& cell = row[x];
+
+      if (cell.matchEdge(Edge::N)) {
         if (y == 0) return (false);
-        if (!this->cells[std::pair<int, int>(x, y - 1)]->matchEdge(Edge::S)) return (false);
+        if (!row[x - cols].matchEdge(Edge::S)) return (false);
       }
 
-      if (cell->matchEdge(Edge::S)) {
+      if (cell.matchEdge(Edge::S)) {
         if (y >= this->gridRows - 1) return (false);
-        if (!this->cells[std::pair<int, int>(x, y + 1)]->matchEdge(Edge::N)) return (false);
+        if (!row[x + cols].matchEdge(Edge::N)) return (false);
       }
 
-      if (cell->matchEdge(Edge::E)) {
-        if (x >= this->gridCols - 1) return (false);
-        if (!this->cells[std::pair<int, int>(x + 1, y)]->matchEdge(Edge::W)) return (false);
+      if (cell.matchEdge(Edge::E)) {
+        if (x >= cols - 1) return (false);
+        if (!row[x + 1].matchEdge(Edge::W)) return (false);
       }
 
-      if (cell->matchEdge(Edge::W)) {
+      if (cell.matchEdge(Edge::W)) {
         if (x == 0) return (false);
-        if (!this->cells[std::pair<int, int>(x - 1, y)]->matchEdge(Edge::E)) return (false);
+        if (!row[x - 1].matchEdge(Edge::E)) return (false);
       }
     }
   }
 
-  this->complete = true;
-  return (this->complete);
+  return (true);
 }
 
 
-InfinityGameLogic::InfinityGameLogic(const std::string name, const char* layout) {
-  this->complete = false;
-  this->level = new Level(1, name, layout);
+InfinityGameLogic::InfinityGameLogic(const std::string name, const PackedLevel& layout) {
+  loadNewLevel(1, name, layout);
 }
 
 
-bool InfinityGameLogic::loadNewLevel(const int id, const std::string name, const char* layout) {
+bool InfinityGameLogic::loadNewLevel(const int id, const std::string name, const PackedLevel& layout) {
   this->complete = false;
-  delete this->level;  // delete memory allocations for previous level.
-  this->level = new Level(id, name, layout);
-  if (this->level == nullptr) return (false);
+  freeLevel();  // one arena reset frees all of the previous level.
+  void* memory = this->arena.allocate(sizeof(Level), alignof(Level));
+  this->level = new (memory) Level(id, name, layout, this->arena);
   return (true);
 }
 
 
+void InfinityGameLogic::freeLevel() {
+  if (this->level != nullptr) {
+    this->level->~Level();
+    this->level = nullptr;
+  }
+  this->arena.reset();
+}
+
+
 InfinityGameLogic::~InfinityGameLogic() {
-  delete this->level;
+  freeLevel();
 }
 
 
@@ -226,11 +413,13 @@ void InfinityGameLogic::rotateTile(int x, int y) {
 
 
 bool InfinityGameLogic::update(const float fElaspedTime) {
+  SMLND_TRACE_SCOPE("InfinityGameLogic::update");
   return ((this->level != nullptr) ? this->level->update(fElaspedTime) : false);
 }
 
 
 bool InfinityGameLogic::isLevelComplete() {
+  SMLND_TRACE_SCOPE("InfinityGameLogic::isLevelComplete");
   bool completed = (this->level != nullptr) ? this->level->isComplete() : false;
   if (completed && (this->level->id > this->lvlCleared)) this->lvlCleared = this->level->id;
   return (completed);
@@ -8,14 +8,16 @@
 #pragma once
 
 #include "smlnd_log.hpp"
+#include "smlnd_arena.hpp"
 
+#include <cstdint>
 #include <string>
-#include <map>
+#include <vector>
 
 namespace smlnd {
 
 // Enumeration values
-enum Glyph {
+enum Glyph : int8_t {
   SBAR = 0, SARC = 1, DARC = 2, TRIO = 3, LEND = 4, QUAD = 5, BLNK = -1
 };
 
@@ -31,10 +33,22 @@ enum Edge {
   N = 0, S = 180, E = 90, W = 270   // north, south, east, and west.
 };
 
+// Connector masks, one bit per edge clockwise from north. A quarter turn clockwise is a rotate left.
+const uint8_t C_N = 1, C_E = 2, C_S = 4, C_W = 8;
+
+inline uint8_t edgeBit(const Edge edge) {
+  return (static_cast<uint8_t>(1 << (edge / 90)));
+}
+
+inline uint8_t rotateConnectors(const uint8_t mask, const int quarters) {
+  int q = quarters & 3;
+  return (static_cast<uint8_t>(((mask << q) | (mask >> (4 - q))) & 0xF));
+}
+
 const int INF_EDGES = 4;                  // Standard number of tile edges.
 const int INF_ANGLEOFFSET = 90;           // Standard user press rotation selected offset.
-const float INF_ANIMATIONSPEED = 0.0009f; // tile animation speed. Needs to be moderated relative to ANGLEDELTA.
-const float INF_ANGLEDELTA = 3.75f;       // tile rotations speeds. Must be integer integral of INF_ANGLEOFFSET.
+const float INF_TURNTIME = 0.4f;          // seconds a tile takes to turn a quarter, at any frame rate.
+const float INF_ANGLEDELTA = 3.75f;       // angle between drawn animation steps. Must divide INF_ANGLEOFFSET.
 
 /**
  * A struct to contain error data if required.
@@ -47,11 +61,72 @@ struct InfinityRpt {
   std::string msg = "no errors occurred";
 };
 
+/**
+ * A fixed size grid of values stored row-major in one block, cell (x, y) is at index y * cols + x.
+ * Iterating it visits the cells in memory order, row by row.
+ */
+template<typename T, typename Alloc = std::allocator<T>>
+class Grid {
+
+private:
+  std::vector<T, Alloc> data;
+  int cols = 0, rows = 0;
+
+public:
+  explicit Grid(const Alloc& alloc = Alloc()) :
+      data(alloc) {
+  }
+
+  void resize(const int cols, const int rows, const T& value = T()) {
+    this->cols = cols;
+    this->rows = rows;
+    this->data.assign(static_cast<size_t>(cols) * rows, value);
+  }
+  int getCols() const {
+    return (this->cols);
+  }
+  int getRows() const {
+    return (this->rows);
+  }
+  int size() const {
+    return (static_cast<int>(this->data.size()));
+  }
+  bool contains(const int x, const int y) const {
+    return (x >= 0 && x < this->cols && y >= 0 && y < this->rows);
+  }
+  // No bounds checks, see contains().
+  T& at(const int x, const int y) {
+    return (this->data[static_cast<size_t>(y) * this->cols + x]);
+  }
+  const T& at(const int x, const int y) const {
+    return (this->data[static_cast<size_t>(y) * this->cols + x]);
+  }
+  T& operator[](const int index) {
+    return (this->data[index]);
+  }
+  const T& operator[](const int index) const {
+    return (this->data[index]);
+  }
+  T* begin() {
+    return (this->data.data());
+  }
+  T* end() {
+    return (this->data.data() + this->data.size());
+  }
+  const T* begin() const {
+    return (this->data.data());
+  }
+  const T* end() const {
+    return (this->data.data() + this->data.size());
+  }
+};
+
 /**
  * This class holds the details pertaining to the current state of a game cell
  * in particulars this class relates details of the edges and alignment mappings, identify
  * the sprite sheet graphic entity that displays the tile.
  * There are currently 6 tile variants.
+ * Cells are small values held directly in the level's grid, a default cell is blank.
  */
 class GameCell {
 
@@ -59,58 +134,154 @@ private:
   bool animating = false;
 
 public:
-  int x, y;
-  int initAngle = 0, targetAngle = 0;
-  float curAngle = 0;
-  float lastUpdated = 0.0f;
-  short* edges;
+  int16_t x = 0, y = 0;
+  Glyph glyph = BLNK;
+  uint8_t quarters = 0;    // clockwise quarter turns from the sprite sheet, 0 to 3, the one turned to.
+  uint8_t connectors = 0;  // at quarters
+  float progress = 1.0f;   // of the current turn, 0 to 1, 1 once settled.
+
+public:
+  GameCell() = default;
+  GameCell(const int x, const int y, const Glyph glyph);
+  void rotate();
+  void update(const float fElaspedTime);
+  // Degrees clockwise, 0 to 360.
+  float getCellRotation() const;
+  // The nearest of stepsPerQuarter drawing steps per quarter turn, 0 to INF_EDGES * stepsPerQuarter - 1.
+  int getCellStep(const int stepsPerQuarter) const;
+  bool isAnimating() {
+    return (this->animating);
+  }
+  // A turning tile connects to nothing.
+  uint8_t getConnectors() const {
+    return (this->animating ? 0 : this->connectors);
+  }
+  bool matchEdge(const Edge edge) const {
+    return ((getConnectors() & edgeBit(edge)) != 0);
+  }
+};
+
+/**
+ * The connectors of a level's settled cells as four bit planes, one bit per cell and each row padded
+ * to whole 64 bit words with room for one bit past the last column. Matching a row's east connectors
+ * against its neighbours' west ones, or its south connectors against the next row's north ones, is
+ * then a shift and compare of 64 cells at a time. Levels don't keep them up to date, they are filled
+ * on demand by Level::fillConnectorRows().
+ */
+class ConnectorRows {
+
+private:
+  ArenaVector<uint64_t> planes;  // N, E, S then W, each rows * words long
+  int rows = 0, words = 0;
+
+public:
+  explicit ConnectorRows(Arena& arena) :
+      planes(ArenaAllocator<uint64_t>(arena)) {
+  }
+  void resize(const int cols, const int rows);
+  void set(const int x, const int y, const uint8_t connectors);
+  bool isClosed() const;
+};
 
-  Glyph glyph;
+typedef Grid<GameCell, ArenaAllocator<GameCell>> CellGrid;
+
+/**
+ * A level layout parsed once, when the assets load: the sprite sheet, the grid size and each cell's
+ * glyph in 3 bits, 21 cells to a 64 bit word with blank as 7. Levels are built from it, so loading
+ * or restarting one reads no text.
+ */
+class PackedLevel {
 
 private:
-  GameCell(const GameCell&) = delete;
-  GameCell& operator=(const GameCell&) = delete;
+  std::vector<uint64_t> glyphs;
 
 public:
-  GameCell(const int x, const int y, const std::string s_glyph);
-  virtual ~GameCell();
-  void rotate();
-  void update(const float fElaspedTime);
-  float getCellRotation() {
-    return (this->curAngle);
+  std::string spriteName;
+  int spriteId = -1;  // the sheet's index in the asset registry, -1 if unknown
+  int cols = 0, rows = 0;
+
+public:
+  static const int CELLS_PER_WORD = 21;
+
+  PackedLevel() = default;
+  // All cells blank.
+  PackedLevel(const std::string spriteName, const int cols, const int rows);
+  // From words as given by getWords(), e.g. stored in a game pack.
+  PackedLevel(const std::string spriteName, const int cols, const int rows, const uint64_t* words);
+  // From the text form "sprite cols rows GLYPH ...", missing or unknown glyphs are blank.
+  static PackedLevel parse(const std::string& layout);
+  Glyph getGlyph(const int index) const {
+    int shift = (index % CELLS_PER_WORD) * 3;
+    int code = static_cast<int>((this->glyphs[index / CELLS_PER_WORD] >> shift) & 7);
+    return ((code == 7) ? BLNK : static_cast<Glyph>(code));
+  }
+  void setGlyph(const int index, const Glyph glyph) {
+    int shift = (index % CELLS_PER_WORD) * 3;
+    uint64_t& word = this->glyphs[index / CELLS_PER_WORD];
+    word = (word & ~(uint64_t(7) << shift)) | (uint64_t(glyph & 7) << shift);
+  }
+  int size() const {
+    return (this->cols * this->rows);
+  }
+  size_t getPackedBytes() const {
+    return (this->glyphs.size() * sizeof(uint64_t));
+  }
+  const uint64_t* getWords() const {
+    return (this->glyphs.data());
   }
-  ;
-  bool matchEdge(const short edge);
 };
 
 /**
  * This class holds the details pertaining to the current level
+ * The level is complete when no connector pair is unmatched. The count is kept up to date as tiles
+ * start and stop turning, looking only at the turned cell's four sides. Building with
+ * INF_CHECK_COMPLETE ("make CHECK=1") cross-checks it against full board scans.
+ * A level's cells and bookkeeping are allocated from the arena it is given, and freed with it.
  */
 class Level {
 
 private:
-  std::map<std::pair<int, int>, GameCell*> cells;
+  CellGrid cells;
+  ArenaVector<int> animatingCells;  // grid indexes of the turning tiles
+  ArenaVector<int> settledCells;    // and of those that stopped turning in the last update
+  int unmatched = 0;  // neighbouring edges that disagree, the board's border counts as a blank cell
   bool complete = false;
 
 public:
   int id = 0;
   std::string name;
   std::string spriteName;
+  int spriteId = -1;
   int gridCols = 0, gridRows = 0;
 
 private:
   Level(const Level&) = delete;
   Level& operator=(const Level&) = delete;
+  int unmatchedAround(const int x, const int y, const uint8_t connectors) const;
+  int countUnmatched() const;
+  void connectorsChanged(const GameCell& cell, const uint8_t before);
 
 public:
-  Level(const int id, const std::string name, const char* layout);
+  Level(const int id, const std::string name, const PackedLevel& layout, Arena& arena);
   virtual ~Level();
-  std::map<std::pair<int, int>, GameCell*>& getGameCells();
+  CellGrid& getGameCells();
+  const ArenaVector<int>& getAnimatingCells() const {
+    return (this->animatingCells);
+  }
+  const ArenaVector<int>& getSettledCells() const {
+    return (this->settledCells);
+  }
   void rotateTile(int x, int y);
   bool update(const float fElaspedTime);
   bool isComplete();
+  bool scanComplete();
+  int getUnmatched() const {
+    return (this->unmatched);
+  }
+  // The connectors as they stand, for cross-checks and benchmarks. Play only keeps the running count.
+  void fillConnectorRows(ConnectorRows& rows) const;
 
-  bool getSize() {
+  int getSize() {
     return (this->cells.size());
   }
 };
@@ -120,14 +291,23 @@ class InfinityGameLogic {
 private:
   bool complete = false;
   unsigned short lvlCleared = 0;
+  Arena arena;  // The current level and all it allocates, reset on each level switch.
 
 public:
-  Level* level;  // An object holding all levels defined.
+  Level* level = nullptr;  // An object holding all levels defined.
+
+private:
+  InfinityGameLogic(const InfinityGameLogic&) = delete;
+  InfinityGameLogic& operator=(const InfinityGameLogic&) = delete;
+  void freeLevel();
 
 public:
-  InfinityGameLogic(const std::string name, const char* layout);
+  InfinityGameLogic(const std::string name, const PackedLevel& layout);
   virtual ~InfinityGameLogic();
-  bool loadNewLevel(const int id, const std::string name, const char* layout);
+  bool loadNewLevel(const int id, const std::string name, const PackedLevel& layout);
+  const Arena& getArena() const {
+    return (this->arena);
+  }
   void rotateTile(int x, int y);
   bool update(const float fElaspedTime);
   unsigned short levelCleared() {
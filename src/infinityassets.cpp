@@ -8,27 +8,488 @@
 
 #include "infinityassets.hpp"
 #include "olcPixelGameEngine.h"
+#include "smlnd_trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace smlnd {
 
-InfinityAssets::InfinityAssets() {
-  loadAssets();
+static void cleanNameStr(std::string& src) {
+  std::string find = "_", replace = " ";
+  for(std::string::size_type i = 0; (i = src.find(find, i)) != std::string::npos;) {
+    src.replace(i, find.length(), replace);
+    i += replace.length();
+  }
+}
+
+/**
+ * A sheet converted with --convert-sprites is mapped, otherwise the PNG is decoded.
+ */
+static olc::Sprite* loadSheet(const std::string& filePath) {
+  olc::Sprite* sprite = new olc::Sprite();
+  if (sprite->LoadFromSprFile(InfinityAssets::getRawSpritePath(filePath)) != olc::OK
+      && sprite->LoadFromSprFile(filePath) != olc::OK)
+    sprite->LoadFromFile(filePath);
+  return (sprite);
+}
+
+// Game pack file, in host byte order: the header, the index of entries, the string table, then the
+// sheets' raw sprite images each starting on a page and the levels' glyph words.
+const char INF_PACKMAGIC[4] = { 'I', 'N', 'F', 'P' };
+const uint32_t INF_PACKVERSION = 1;
+const size_t INF_PACKPAGE = 4096;
+
+struct PackHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t entryCount, entryOffset;
+  uint32_t stringsSize, stringsOffset;
+  uint32_t packNameOffset, packNameLength;  // in the string table
+};
+
+struct PackEntry {
+  uint32_t type;                    // AssetDtls::Type
+  uint32_t nameOffset, nameLength;  // in the string table
+  uint32_t textOffset, textLength;  // file of an audio or save, sheet name of a level
+  uint32_t reserved;
+  uint64_t dataOffset, dataSize;    // sheet image or level glyph words, from the start of the file
+  int32_t values[6];                // sheet: w, h, cell w, cell h, cells across and down. level: cols, rows, sheet
+};
+
+RotatedFrameCache::RotatedFrameCache(olc::Sprite* sheet, const int cell_w, const int cell_h, const int cell_x_cnt,
+    const int cell_y_cnt, const int stepsPerQuarter) {
+  this->sheet = sheet;
+  this->cell_w = cell_w;
+  this->cell_h = cell_h;
+  this->cell_x_cnt = cell_x_cnt;
+  this->cell_y_cnt = cell_y_cnt;
+  this->stepsPerQuarter = stepsPerQuarter;
+  this->frames.assign(cell_y_cnt * getStepCount(), nullptr);
+}
+
+RotatedFrameCache::~RotatedFrameCache() {
+  for (auto frame : this->frames) {
+    if (frame == nullptr) continue;
+    delete frame->sprite;
+    delete frame;
+  }
+}
+
+RotatedFrame* RotatedFrameCache::getFrame(const int row, const int step) {
+  if (row < 0 || row >= this->cell_y_cnt || step < 0 || step >= getStepCount()) return (nullptr);
+
+  RotatedFrame*& frame = this->frames[row * getStepCount() + step];
+  if (frame == nullptr) {
+    frame = renderFrame(row, step);
+    this->bytes += static_cast<size_t>(frame->sprite->width) * frame->sprite->height * sizeof(olc::Pixel);
+  }
+  return (frame);
+}
+
+/**
+ * Renders the cell through the engine into a scratch sprite, starting from the nearest
+ * quarter turn cell on the sheet. The result is cropped to its visible pixels, usually
+ * no larger than the cell for round tile artwork.
+ */
+RotatedFrame* RotatedFrameCache::renderFrame(const int row, const int step) {
+
+  // Big enough for the cell diagonal, keeping the same odd/even-ness as the cell so
+  // both share an exact centre.
+  int diag = static_cast<int>(ceil(sqrt(this->cell_w * this->cell_w + this->cell_h * this->cell_h)));
+  int bound_w = diag + ((diag - this->cell_w) & 1);
+  int bound_h = diag + ((diag - this->cell_h) & 1);
+  olc::Sprite bound(bound_w, bound_h);
+
+  int quarter = step / this->stepsPerQuarter;
+  float angle = (step % this->stepsPerQuarter) * (90.0f / this->stepsPerQuarter);
+
+  olc::Sprite* target = pge->GetDrawTarget();
+  olc::Pixel::Mode mode = pge->GetPixelMode();
+  pge->SetDrawTarget(&bound);
+  pge->SetPixelMode(olc::Pixel::NORMAL);
+  pge->Clear(olc::BLANK);
+  pge->DrawRotatedPartialSprite(bound_w / 2, bound_h / 2, this->sheet, quarter * this->cell_w, row * this->cell_h,
+      this->cell_w, this->cell_h, angle);
+  pge->SetPixelMode(mode);
+  pge->SetDrawTarget(target);
+
+  int min_x = bound_w, min_y = bound_h, max_x = -1, max_y = -1;
+  for (int y = 0; y < bound_h; y++) {
+    for (int x = 0; x < bound_w; x++) {
+      if (bound.GetPixel(x, y).a == 0) continue;
+      min_x = std::min(min_x, x);
+      max_x = std::max(max_x, x);
+      min_y = std::min(min_y, y);
+      max_y = std::max(max_y, y);
+    }
+  }
+
+  RotatedFrame* frame = new RotatedFrame();
+  if (max_x < 0) {
+    frame->sprite = new olc::Sprite(0, 0);
+    return (frame);
+  }
+
+  frame->sprite = new olc::Sprite(max_x - min_x + 1, max_y - min_y + 1);
+  frame->off_x = min_x - (bound_w - this->cell_w) / 2;
+  frame->off_y = min_y - (bound_h - this->cell_h) / 2;
+  for (int y = 0; y < frame->sprite->height; y++)
+    for (int x = 0; x < frame->sprite->width; x++)
+      frame->sprite->SetPixel(x, y, bound.GetPixel(min_x + x, min_y + y));
+
+  return (frame);
+}
+
+int NameTable::intern(const std::string& name) {
+  int index = find(name);
+  if (index != -1) return (index);
+
+  // Keep the table at most half full.
+  if ((this->names.size() + 1) * 2 > this->slots.size()) rehash(std::max<size_t>(16, this->slots.size() * 2));
+  index = static_cast<int>(this->names.size());
+  this->names.push_back(name);
+
+  size_t mask = this->slots.size() - 1;
+  size_t slot = hash(name.data(), name.size()) & mask;
+  while (this->slots[slot] != -1)
+    slot = (slot + 1) & mask;
+  this->slots[slot] = index;
+  return (index);
+}
+
+int NameTable::find(const char* name, const size_t length) const {
+  if (this->slots.empty()) return (-1);
+
+  size_t mask = this->slots.size() - 1;
+  for (size_t slot = hash(name, length) & mask; this->slots[slot] != -1; slot = (slot + 1) & mask) {
+    const std::string& candidate = this->names[this->slots[slot]];
+    if (candidate.size() == length && candidate.compare(0, length, name, length) == 0) return (this->slots[slot]);
+  }
+  return (-1);
+}
+
+// FNV-1a.
+uint32_t NameTable::hash(const char* name, const size_t length) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    h ^= static_cast<uint8_t>(name[i]);
+    h *= 16777619u;
+  }
+  return (h);
+}
+
+void NameTable::rehash(const size_t slotCount) {
+  this->slots.assign(slotCount, -1);
+  size_t mask = slotCount - 1;
+  for (size_t i = 0; i < this->names.size(); i++) {
+    size_t slot = hash(this->names[i].data(), this->names[i].size()) & mask;
+    while (this->slots[slot] != -1)
+      slot = (slot + 1) & mask;
+    this->slots[slot] = static_cast<int>(i);
+  }
+}
+
+InfinityAssets::InfinityAssets(const std::string& packFile) {
+  if (packFile.empty() || !loadPack(packFile)) {
+    if (!packFile.empty()) SMLND_DBG_LOG_M("Game pack not loaded, reading the resource file instead of ", packFile);
+    loadAssets();
+  }
+  this->m_manifestTime = getElapsed();
+  startLoaders();
+}
+
+InfinityAssets::~InfinityAssets() {
+  {
+    std::lock_guard<std::mutex> lock(this->m_loadLock);
+    this->m_stopping = true;
+  }
+  this->m_taskReady.notify_all();
+  for (std::thread& loader : this->m_loaders)
+    loader.join();
+
+  for (AssetDtls& ad : this->m_sprites) {
+    delete ad.rotated;
+    delete ad.sprite;
+  }
+  for (AssetDtls& ad : this->m_levels)
+    delete ad.levelData;
+#ifndef _WIN32
+  if (this->m_pack != nullptr) munmap(this->m_pack, this->m_packSize);
+#endif
+}
+
+AssetDtls* InfinityAssets::getSprite(const std::string& name) {
+  return (getSprite(m_spriteNames.find(name)));
+}
+
+AssetDtls* InfinityAssets::getSprite(const int index) {
+  if (index < 0 || index >= static_cast<int>(m_sprites.size())) return (nullptr);
+  prefetchSprite(index);
+  return (&m_sprites[index]);
 }
 
-AssetDtls* InfinityAssets::getSprite(const std::string name) {
-  return (m_assets[name + ".sprite"]);
+const AssetDtls* InfinityAssets::peekSprite(const int index) const {
+  return ((index >= 0 && index < static_cast<int>(m_sprites.size())) ? &m_sprites[index] : nullptr);
 }
 
-AssetDtls* InfinityAssets::getAudio(const std::string name) {
-  return (m_assets[name + ".sound"]);
+std::string InfinityAssets::getRawSpritePath(const std::string& filePath) {
+  std::string::size_type dot = filePath.find_last_of("./");
+  if (dot == std::string::npos || filePath[dot] == '/') return (filePath + ".rgba");
+  return (filePath.substr(0, dot) + ".rgba");
+}
+
+AssetDtls* InfinityAssets::getAudio(const std::string& name) {
+  int index = m_audioNames.find(name);
+  return ((index != -1) ? &m_audio[index] : nullptr);
 }
 
 AssetDtls* InfinityAssets::getLevel(const int id) {
-  return (m_assets[id + ".level"]);
+  if (id < 1 || id > static_cast<int>(m_levels.size())) return (nullptr);
+
+  if (!this->m_levelReady[id - 1].load(std::memory_order_acquire)) {
+    SMLND_TRACE_SCOPE("InfinityAssets::waitForLevel");
+    std::unique_lock<std::mutex> lock(this->m_loadLock);
+    this->m_loadDone.wait(lock, [&]() {return (this->m_levelReady[id - 1].load(std::memory_order_relaxed));});
+  }
+  return (&m_levels[id - 1]);
+}
+
+AssetDtls* InfinityAssets::getSaved(const std::string& packName) {
+  int index = m_savedNames.find(packName);
+  return ((index != -1) ? &m_saved[index] : nullptr);
+}
+
+void InfinityAssets::prefetchSprite(const int index) {
+  if (index < 0 || index >= static_cast<int>(m_sprites.size())) return;
+
+  std::lock_guard<std::mutex> lock(this->m_loadLock);
+  requestSprite(index);
+  trimSprites();
+}
+
+bool InfinityAssets::waitForSprite(AssetDtls* ad) {
+  if (ad == nullptr) return (false);
+
+  std::unique_lock<std::mutex> lock(this->m_loadLock);
+  awaitSprite(lock, ad->id);
+  return (ad->sprite != nullptr);
+}
+
+void InfinityAssets::pinSprite(AssetDtls* ad) {
+  if (ad == nullptr) return;
+
+  std::lock_guard<std::mutex> lock(this->m_loadLock);
+  this->m_spriteSlots[ad->id].pins++;
+  requestSprite(ad->id);
+}
+
+void InfinityAssets::unpinSprite(AssetDtls* ad) {
+  if (ad == nullptr) return;
+
+  std::lock_guard<std::mutex> lock(this->m_loadLock);
+  SpriteSlot& slot = this->m_spriteSlots[ad->id];
+  if (slot.pins > 0) slot.pins--;
+  trimSprites();
+}
+
+void InfinityAssets::setSpriteBudget(const size_t bytes) {
+  std::lock_guard<std::mutex> lock(this->m_loadLock);
+  this->m_spriteBudget = bytes;
+  trimSprites();
+}
+
+size_t InfinityAssets::getResidentBytes() {
+  std::lock_guard<std::mutex> lock(this->m_loadLock);
+  return (residentBytes());
+}
+
+/**
+ * The cache is made under the lock, as loaders free it with the sheet, and the sheet is held like a
+ * pin until then.
+ */
+RotatedFrameCache* InfinityAssets::getRotatedFrames(AssetDtls* ad, const int stepsPerQuarter) {
+  if (ad == nullptr) return (nullptr);
+
+  std::unique_lock<std::mutex> lock(this->m_loadLock);
+  SpriteSlot& slot = this->m_spriteSlots[ad->id];
+  slot.pins++;
+  awaitSprite(lock, ad->id);
+  if (ad->sprite != nullptr && ad->rotated == nullptr) {
+    ad->rotated = new RotatedFrameCache(ad->sprite, ad->asset_cell_w, ad->asset_cell_h, ad->asset_cell_x_cnt,
+        ad->asset_cell_y_cnt, stepsPerQuarter);
+  }
+  slot.pins--;
+  return (ad->rotated);
+}
+
+bool InfinityAssets::isLoaded() {
+  std::lock_guard<std::mutex> lock(this->m_loadLock);
+  return (this->m_busy == 0);
 }
 
-AssetDtls* InfinityAssets::getSaved(const std::string packName) {
-  return (m_assets[packName + ".saved"]);
+void InfinityAssets::waitForLoad() {
+  std::unique_lock<std::mutex> lock(this->m_loadLock);
+  this->m_loadDone.wait(lock, [&]() {return (this->m_busy == 0);});
+}
+
+std::vector<AssetLoadStat> InfinityAssets::getLoadStats() {
+  std::lock_guard<std::mutex> lock(this->m_loadLock);
+  return (this->m_loadStats);
+}
+
+/**
+ * Marks the sheet as just used and queues its decode if it isn't in memory or on the way.
+ * Call with m_loadLock held.
+ */
+void InfinityAssets::requestSprite(const int index) {
+  SpriteSlot& slot = this->m_spriteSlots[index];
+  slot.lastUse = ++this->m_useClock;
+  if (slot.state != SpriteSlot::UNLOADED) return;
+
+  slot.state = SpriteSlot::LOADING;
+  this->m_queue.push_back(LoadTask { AssetDtls::Type::SPRITE, index, "" });
+  this->m_busy++;
+  this->m_taskReady.notify_one();
+}
+
+/**
+ * Waits until the sheet is in memory, asking for it if need be. It is held like a pin meanwhile, so a
+ * loader's trim can't free it again before this wakes. Call with m_loadLock held through lock.
+ */
+void InfinityAssets::awaitSprite(std::unique_lock<std::mutex>& lock, const int index) {
+  SpriteSlot& slot = this->m_spriteSlots[index];
+  if (slot.state == SpriteSlot::RESIDENT) return;
+
+  SMLND_TRACE_SCOPE("InfinityAssets::waitForSprite");
+  slot.pins++;
+  requestSprite(index);
+  this->m_loadDone.wait(lock, [&]() {return (slot.state == SpriteSlot::RESIDENT);});
+  slot.pins--;
+}
+
+/**
+ * Bytes held by the decoded sheets and their rotated frames. Call with m_loadLock held.
+ */
+size_t InfinityAssets::residentBytes() const {
+  size_t bytes = 0;
+  for (size_t i = 0; i < this->m_sprites.size(); i++) {
+    if (this->m_spriteSlots[i].state != SpriteSlot::RESIDENT) continue;
+    const AssetDtls& ad = this->m_sprites[i];
+    if (ad.sprite != nullptr) bytes += static_cast<size_t>(ad.sprite->width) * ad.sprite->height * sizeof(olc::Pixel);
+    if (ad.rotated != nullptr) bytes += ad.rotated->getBytes();
+  }
+  return (bytes);
+}
+
+/**
+ * Frees the least recently used unpinned sheets, with their rotated frames, until what is left fits
+ * the budget. Pinned sheets stay whatever their size. Call with m_loadLock held.
+ */
+void InfinityAssets::trimSprites() {
+  size_t bytes = residentBytes();
+  while (bytes > this->m_spriteBudget) {
+    int victim = -1;
+    for (size_t i = 0; i < this->m_spriteSlots.size(); i++) {
+      const SpriteSlot& slot = this->m_spriteSlots[i];
+      if (slot.state != SpriteSlot::RESIDENT || slot.pins > 0) continue;
+      if (victim == -1 || slot.lastUse < this->m_spriteSlots[victim].lastUse) victim = static_cast<int>(i);
+    }
+    if (victim == -1) return;
+
+    AssetDtls& ad = this->m_sprites[victim];
+    SMLND_DBG_LOG_M("Evicting sprite sheet = ", ad.name);
+    delete ad.rotated;
+    delete ad.sprite;
+    ad.rotated = nullptr;
+    ad.sprite = nullptr;
+    this->m_spriteSlots[victim].state = SpriteSlot::UNLOADED;
+    bytes = residentBytes();
+  }
+}
+
+/**
+ * Starts the loaders on the levels queued by loadAssets(), a pack's levels are ready already.
+ * Sheets are queued as they are asked for.
+ */
+void InfinityAssets::startLoaders() {
+  this->m_spriteSlots.resize(this->m_sprites.size());
+  this->m_levelReady.reset(new std::atomic<bool>[this->m_levels.size()]);
+  for (size_t i = 0; i < this->m_levels.size(); i++)
+    this->m_levelReady[i] = (this->m_pack != nullptr);
+  this->m_busy = static_cast<int>(this->m_queue.size());
+
+  int loaders = std::min(INF_LOADERS, std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+  for (int i = 0; i < loaders; i++)
+    this->m_loaders.emplace_back(&InfinityAssets::runLoader, this, i);
+}
+
+void InfinityAssets::runLoader(const int worker) {
+  SMLND_TRACE_THREAD("loader");
+
+  std::unique_lock<std::mutex> lock(this->m_loadLock);
+  for (;;) {
+    this->m_taskReady.wait(lock, [&]() {return (this->m_stopping || !this->m_queue.empty());});
+    if (this->m_stopping) return;
+
+    LoadTask task = this->m_queue.front();
+    this->m_queue.pop_front();
+    lock.unlock();
+
+    AssetLoadStat stat;
+    stat.worker = worker;
+    stat.start = getElapsed();
+    olc::Sprite* sprite = nullptr;
+    PackedLevel* packed = nullptr;
+    if (task.type == AssetDtls::Type::SPRITE) {
+      SMLND_TRACE_SCOPE("InfinityAssets::decodeSprite");
+      const AssetDtls& ad = this->m_sprites[task.index];
+      if (ad.packData != nullptr) {
+        // Checked when the pack was loaded. Should it still fail the sheet is left empty, as for a
+        // PNG that doesn't decode.
+        sprite = new olc::Sprite();
+        if (sprite->LoadFromSprMemory(ad.packData, ad.packSize) != olc::OK)
+          SMLND_DBG_LOG_M("Bad sprite sheet in game pack = ", ad.name);
+      } else {
+        sprite = loadSheet(ad.filePath);
+      }
+      stat.bytes = static_cast<size_t>(sprite->width) * sprite->height * sizeof(olc::Pixel);
+      stat.mapped = sprite->IsMapped() || (ad.packData != nullptr && sprite->GetData() != nullptr);
+    } else {
+      SMLND_TRACE_SCOPE("InfinityAssets::parseLevel");
+      packed = new PackedLevel(PackedLevel::parse(task.layout));
+      packed->spriteId = this->m_spriteNames.find(packed->spriteName);
+      stat.bytes = packed->getPackedBytes();
+    }
+    stat.end = getElapsed();
+
+    lock.lock();
+    if (task.type == AssetDtls::Type::SPRITE) {
+      AssetDtls& ad = this->m_sprites[task.index];
+      ad.sprite = sprite;
+      this->m_spriteSlots[task.index].state = SpriteSlot::RESIDENT;
+      stat.asset = &ad;
+      // A prefetched sheet counts against the budget as soon as it is in memory.
+      trimSprites();
+    } else {
+      AssetDtls& ad = this->m_levels[task.index];
+      ad.levelData = packed;
+      this->m_levelReady[task.index].store(true, std::memory_order_release);
+      stat.asset = &ad;
+    }
+    this->m_loadStats.push_back(stat);
+    this->m_busy--;
+    this->m_loadDone.notify_all();
+  }
 }
 
 bool InfinityAssets::saveLevel(const AssetDtls* ad, unsigned short levelId) {
@@ -56,48 +517,271 @@ bool InfinityAssets::saveLevel(const AssetDtls* ad, unsigned short levelId) {
 }
 
 
-void InfinityAssets::loadAssets() {
-
-  SMLND_DBG_LOG("Inside loadAssets");
+/**
+ * Sheets come from their raw sprite files or PNGs, levels as already packed. Saves are referred to
+ * by file, so progress still goes to the save file.
+ */
+bool InfinityAssets::compilePack(const std::string& packFile) {
+  PackHeader header;
+  memset(&header, 0, sizeof(header));
+  std::vector<PackEntry> entries;
+  std::vector<std::string> data;  // by entry
+  std::string strings;
+
+  auto addString = [&](const std::string& str, uint32_t& offset, uint32_t& length) {
+    offset = static_cast<uint32_t>(strings.size());
+    length = static_cast<uint32_t>(str.size());
+    strings += str;
+  };
+  auto addEntry = [&](const AssetDtls& ad, const std::string& text, const std::string& bytes) -> PackEntry& {
+    PackEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.type = ad.type;
+    addString(ad.name, entry.nameOffset, entry.nameLength);
+    addString(text, entry.textOffset, entry.textLength);
+    entries.push_back(entry);
+    data.push_back(bytes);
+    return (entries.back());
+  };
 
-  auto cleanNameStr = [&](std::string& src) {
-    std::string find = "_", replace = " ";
-    for(std::string::size_type i = 0; (i = src.find(find, i)) != std::string::npos;) {
-      src.replace(i, find.length(), replace);
-      i += replace.length();
+  for (const AssetDtls& ad : this->m_sprites) {
+    std::unique_ptr<olc::Sprite> sheet(loadSheet(ad.filePath));
+    sheet->cellWidth = ad.asset_cell_w;
+    sheet->cellHeight = ad.asset_cell_h;
+    std::ostringstream image;
+    if (sheet->SaveToSprFile(image) != olc::OK) {
+      SMLND_DBG_LOG_M("compilePack: no sprite sheet in ", ad.filePath);
+      return (false);
     }
+    PackEntry& entry = addEntry(ad, "", image.str());
+    int32_t values[] = { ad.asset_w, ad.asset_h, ad.asset_cell_w, ad.asset_cell_h, ad.asset_cell_x_cnt,
+        ad.asset_cell_y_cnt };
+    memcpy(entry.values, values, sizeof(values));
+  }
+  for (const AssetDtls& ad : this->m_audio)
+    addEntry(ad, ad.filePath, "");
+  for (int id = 1; getLevel(id) != nullptr; id++) {
+    const PackedLevel* level = getLevel(id)->levelData;
+    PackEntry& entry = addEntry(*getLevel(id), level->spriteName,
+        std::string(reinterpret_cast<const char*>(level->getWords()), level->getPackedBytes()));
+    entry.values[0] = level->cols;
+    entry.values[1] = level->rows;
+    entry.values[2] = level->spriteId;
+  }
+  for (const AssetDtls& ad : this->m_saved)
+    addEntry(ad, ad.filePath, "");
+
+  memcpy(header.magic, INF_PACKMAGIC, sizeof(INF_PACKMAGIC));
+  header.version = INF_PACKVERSION;
+  addString(this->pack_name, header.packNameOffset, header.packNameLength);
+  header.entryCount = static_cast<uint32_t>(entries.size());
+  header.entryOffset = sizeof(PackHeader);
+  header.stringsOffset = header.entryOffset + header.entryCount * sizeof(PackEntry);
+  header.stringsSize = static_cast<uint32_t>(strings.size());
+
+  // Sheets start on a page, so each maps on its own, glyph words on a word.
+  size_t offset = header.stringsOffset + header.stringsSize;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (data[i].empty()) continue;
+    size_t align = (entries[i].type == AssetDtls::Type::SPRITE) ? INF_PACKPAGE : sizeof(uint64_t);
+    offset = (offset + align - 1) & ~(align - 1);
+    entries[i].dataOffset = offset;
+    entries[i].dataSize = data[i].size();
+    offset += data[i].size();
+  }
+
+  std::ofstream pack(packFile, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!pack.is_open()) return (false);
+  pack.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  pack.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PackEntry));
+  pack.write(strings.data(), strings.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (data[i].empty()) continue;
+    while (static_cast<uint64_t>(pack.tellp()) < entries[i].dataOffset)
+      pack.put(0);
+    pack.write(data[i].data(), data[i].size());
+  }
+  pack.close();
+  return (!pack.fail());
+}
+
+/**
+ * Maps the pack and checks all of its index before taking anything from it, so a bad pack leaves
+ * the registry empty for the resource file.
+ */
+bool InfinityAssets::loadPack(const std::string& packFile) {
+  SMLND_TRACE_SCOPE("InfinityAssets::loadPack");
+#ifdef _WIN32
+  return (false);
+#else
+  int fd = open(packFile.c_str(), O_RDONLY);
+  if (fd < 0) return (false);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(PackHeader))) {
+    close(fd);
+    return (false);
+  }
+
+  // Private and writable like a mapped sprite file, drawing on a sheet copies its pages.
+  size_t size = static_cast<size_t>(st.st_size);
+  void* pack = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (pack == MAP_FAILED) return (false);
+
+  uint8_t* base = static_cast<uint8_t*>(pack);
+  const PackHeader* header = reinterpret_cast<const PackHeader*>(base);
+  const PackEntry* entries = reinterpret_cast<const PackEntry*>(base + header->entryOffset);
+  const char* strings = reinterpret_cast<const char*>(base + header->stringsOffset);
+
+  auto inPack = [&](const uint64_t offset, const uint64_t length) {
+    return (offset <= size && length <= size - offset);
+  };
+  auto inStrings = [&](const uint32_t offset, const uint32_t length) {
+    return (static_cast<uint64_t>(offset) + length <= header->stringsSize);
   };
+  bool valid = memcmp(header->magic, INF_PACKMAGIC, sizeof(INF_PACKMAGIC)) == 0
+      && header->version == INF_PACKVERSION && header->entryOffset % alignof(PackEntry) == 0
+      && inPack(header->entryOffset, static_cast<uint64_t>(header->entryCount) * sizeof(PackEntry))
+      && inPack(header->stringsOffset, header->stringsSize)
+      && inStrings(header->packNameOffset, header->packNameLength);
+  for (uint32_t i = 0; valid && i < header->entryCount; i++) {
+    const PackEntry& entry = entries[i];
+    valid = entry.type <= AssetDtls::Type::SAVED && inStrings(entry.nameOffset, entry.nameLength)
+        && inStrings(entry.textOffset, entry.textLength) && inPack(entry.dataOffset, entry.dataSize);
+    if (valid && entry.type == AssetDtls::Type::SPRITE) {
+      // Only the image header is read, the pixels aren't touched until the sheet is drawn.
+      olc::Sprite sheet;
+      const int32_t* v = entry.values;  // w, h, cell w, cell h, cells across, cells down
+      valid = entry.dataOffset % 16 == 0
+          && sheet.LoadFromSprMemory(base + entry.dataOffset, entry.dataSize) == olc::OK
+          && sheet.width == v[0] && sheet.height == v[1] && sheet.cellWidth == v[2] && sheet.cellHeight == v[3]
+          && v[2] > 0 && v[3] > 0 && v[4] > 0 && v[5] > 0
+          && static_cast<int64_t>(v[2]) * v[4] <= v[0] && static_cast<int64_t>(v[3]) * v[5] <= v[1];
+    }
+    if (valid && entry.type == AssetDtls::Type::LEVEL) {
+      int64_t cells = static_cast<int64_t>(entry.values[0]) * entry.values[1];
+      valid = entry.values[0] >= 0 && entry.values[1] >= 0 && entry.dataOffset % sizeof(uint64_t) == 0
+          && ((cells + PackedLevel::CELLS_PER_WORD - 1) / PackedLevel::CELLS_PER_WORD) * sizeof(uint64_t)
+              <= entry.dataSize;
+    }
+  }
+  if (!valid) {
+    munmap(pack, size);
+    return (false);
+  }
+
+  this->m_pack = pack;
+  this->m_packSize = size;
+  this->pack_name.assign(strings + header->packNameOffset, header->packNameLength);
+  for (uint32_t i = 0; i < header->entryCount; i++) {
+    const PackEntry& entry = entries[i];
+    AssetDtls ad;
+    ad.type = static_cast<AssetDtls::Type>(entry.type);
+    ad.name.assign(strings + entry.nameOffset, entry.nameLength);
+    std::string text(strings + entry.textOffset, entry.textLength);
+
+    switch (ad.type) {
+    case AssetDtls::Type::SPRITE:
+      if (m_spriteNames.find(ad.name) != -1) break;
+      ad.id = static_cast<int>(m_sprites.size());
+      ad.filePath = packFile;
+      ad.asset_w = entry.values[0];
+      ad.asset_h = entry.values[1];
+      ad.asset_cell_w = entry.values[2];
+      ad.asset_cell_h = entry.values[3];
+      ad.asset_cell_x_cnt = entry.values[4];
+      ad.asset_cell_y_cnt = entry.values[5];
+      ad.packData = base + entry.dataOffset;
+      ad.packSize = entry.dataSize;
+      this->numSprites++;
+      m_spriteNames.intern(ad.name);
+      m_sprites.push_back(ad);
+      break;
+
+    case AssetDtls::Type::AUDIO:
+      if (m_audioNames.find(ad.name) != -1) break;
+      ad.filePath = text;
+      this->numAudio++;
+      m_audioNames.intern(ad.name);
+      m_audio.push_back(ad);
+      break;
+
+    case AssetDtls::Type::LEVEL:
+      this->numLevels++;
+      ad.id = this->numLevels;
+      // A level without cells has no glyph words.
+      if (entry.dataSize > 0) {
+        ad.levelData = new PackedLevel(text, entry.values[0], entry.values[1],
+            reinterpret_cast<const uint64_t*>(base + entry.dataOffset));
+      } else {
+        ad.levelData = new PackedLevel(text, entry.values[0], entry.values[1]);
+      }
+      ad.levelData->spriteId = entry.values[2];
+      m_levels.push_back(ad);
+      break;
+
+    case AssetDtls::Type::SAVED:
+      loadSaved(&ad, text);
+      if (m_savedNames.find(ad.name) != -1) break;
+      m_savedNames.intern(ad.name);
+      m_saved.push_back(ad);
+      break;
+    }
+  }
+
+  // Sheets the pack's levels name, checked against what it holds.
+  for (AssetDtls& level : m_levels) {
+    int& spriteId = level.levelData->spriteId;
+    if (spriteId < 0 || spriteId >= static_cast<int>(m_sprites.size())) spriteId = -1;
+  }
+  return (true);
+#endif
+}
+
+void InfinityAssets::loadSaved(AssetDtls* ad, const std::string& filePath) {
+
+  std::ifstream saved(filePath, std::ios::in | std::ios::binary);
+
+  ad->filePath = filePath;
 
+  if (saved.is_open()) {
+    std::string ts;
+    saved >> ts;
+    cleanNameStr(ts);
+    ad->name = ts;
+    saved >> ad->id;
+  }
+  SMLND_DBG_LOG_M("LoadSaved() level for game pack = ", ad->name);
+  saved.close();
+}
+
+void InfinityAssets::loadAssets() {
+  SMLND_TRACE_SCOPE("InfinityAssets::loadAssets");
+
+  SMLND_DBG_LOG("Inside loadAssets");
+
+  // Sheets are decoded by the loaders when first asked for, the sprite's id is its index.
   auto loadSpr = [&](AssetDtls* ad) {
-    ad->sprite = new olc::Sprite(ad->filePath);
+    ad->id = static_cast<int>(m_sprites.size());
   };
 
   auto loadAudio = [&](AssetDtls* ad) {
     // todo ad->audio = new olc::AudioFile(ad->filePath);
     };
 
+  // Layouts are parsed by the loaders.
   auto loadLevel = [&](AssetDtls* ad, std::ifstream& data) {
     std::string buffer;
     getline(data, buffer);
-    ad->rawlevelData = new std::string(buffer);
-    SMLND_DBG_LOG_M("LoadLevel() raw data = ", *ad->rawlevelData);
+    SMLND_DBG_LOG_M("LoadLevel() raw data = ", buffer);
+    this->m_queue.push_back(LoadTask { AssetDtls::Type::LEVEL, static_cast<int>(m_levels.size()), buffer });
   };
 
-  auto loadSaved = [&](AssetDtls* ad, std::string& filePath) {
-
-    std::ifstream saved(filePath, std::ios::in | std::ios::binary);
-
-    ad->filePath = filePath;
-
-    if (saved.is_open()) {
-      std::string ts;
-      saved >> ts;
-      cleanNameStr(ts);
-      ad->name = ts;
-      saved >> ad->id;
-    }
-    SMLND_DBG_LOG_M("LoadSaved() level for game pack = ", ad->name);
-    saved.close();
+  // The first asset of a name wins, later ones are skipped.
+  auto isDuplicate = [&](const NameTable& names, const AssetDtls& ad) {
+    if (names.find(ad.name) == -1) return (false);
+    SMLND_DBG_LOG_M("Duplicate asset name skipped in resource.dat file = ", ad.name);
+    return (true);
   };
 
 
@@ -129,58 +813,72 @@ void InfinityAssets::loadAssets() {
         continue;
       }
 
-      AssetDtls* ad = new AssetDtls();
-
-      if (tType == "SPRITE") ad->type = AssetDtls::Type::SPRITE;
-      if (tType == "AUDIO") ad->type = AssetDtls::Type::AUDIO;
-      if (tType == "LEVEL") ad->type = AssetDtls::Type::LEVEL;
-      if (tType == "SAVED") ad->type = AssetDtls::Type::SAVED;
+      AssetDtls ad;
+
+      if (tType == "SPRITE") ad.type = AssetDtls::Type::SPRITE;
+      else if (tType == "AUDIO") ad.type = AssetDtls::Type::AUDIO;
+      else if (tType == "LEVEL") ad.type = AssetDtls::Type::LEVEL;
+      else if (tType == "SAVED") ad.type = AssetDtls::Type::SAVED;
+      else {
+        if (!tType.empty()) {
+          getline(data, tType);
+          SMLND_DBG_LOG_M("Unknown asset type in resource.dat file = ", tType);
+        }
+        continue;
+      }
 
       // Next element should be name string reference. Clean it.
       std::string name;
       data >> name;
       cleanNameStr(name);
-      ad->name = name;
-
-      switch (ad->type) {
-      case ad->Type::SPRITE:
+      ad.name = name;
+
+      switch (ad.type) {
+      case AssetDtls::Type::SPRITE:
+        data >> ad.filePath;
+        data >> ad.asset_w;
+        data >> ad.asset_h;
+        data >> ad.asset_cell_w;
+        data >> ad.asset_cell_h;
+        data >> ad.asset_cell_x_cnt;
+        data >> ad.asset_cell_y_cnt;
+        if (isDuplicate(m_spriteNames, ad)) break;
         this->numSprites++;
-        data >> ad->filePath;
-        SMLND_DBG_LOG_M("Loading sprite resource from filePath = ", ad->filePath);
-        data >> ad->asset_w;
-        data >> ad->asset_h;
-        data >> ad->asset_cell_w;
-        data >> ad->asset_cell_h;
-        data >> ad->asset_cell_x_cnt;
-        data >> ad->asset_cell_y_cnt;
-        loadSpr(ad);
-        m_assets[ad->name + ".sprite"] = ad;
+        SMLND_DBG_LOG_M("Loading sprite resource from filePath = ", ad.filePath);
+        loadSpr(&ad);
+        m_spriteNames.intern(ad.name);
+        m_sprites.push_back(ad);
         break;
 
-      case ad->Type::AUDIO:
+      case AssetDtls::Type::AUDIO:
+        data >> ad.filePath;
+        if (isDuplicate(m_audioNames, ad)) break;
         this->numAudio++;
-        data >> ad->filePath;
-        SMLND_DBG_LOG_M("Loading audio resource from filePath = ", ad->filePath);
-        loadAudio(ad);
-        m_assets.emplace(ad->name + ".audio", ad);
+        SMLND_DBG_LOG_M("Loading audio resource from filePath = ", ad.filePath);
+        loadAudio(&ad);
+        m_audioNames.intern(ad.name);
+        m_audio.push_back(ad);
         break;
 
-      case ad->Type::LEVEL:
+      case AssetDtls::Type::LEVEL:
         this->numLevels++;
-        ad->id = this->numLevels;
-        SMLND_DBG_LOG_M("Loading level data for name = ", ad->name);
-        loadLevel(ad, data);
-        m_assets.emplace(ad->id + ".level", ad);
+        ad.id = this->numLevels;
+        SMLND_DBG_LOG_M("Loading level data for name = ", ad.name);
+        loadLevel(&ad, data);
+        m_levels.push_back(ad);
         break;
 
-      case ad->Type::SAVED:
-        SMLND_DBG_LOG_M("Loading saved level data from = ", ad->name);
+      case AssetDtls::Type::SAVED: {
+        SMLND_DBG_LOG_M("Loading saved level data from = ", ad.name);
         std::string filePath;
         data >> filePath;
-        loadSaved(ad, filePath);
-        m_assets.emplace(ad->name + ".saved", ad);
+        loadSaved(&ad, filePath);
+        if (isDuplicate(m_savedNames, ad)) break;
+        m_savedNames.intern(ad.name);
+        m_saved.push_back(ad);
         break;
       }
+      }
     }
 
     data.close();
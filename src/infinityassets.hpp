@@ -10,58 +10,256 @@
 
 #include "olcPixelGameEngine.h"
 #include "smlnd_log.hpp"
+#include "InfinityGameLogic.hpp"
 
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
 #include <mutex>
+#include <thread>
 #include <vector>
 #include <fstream>
 
 namespace smlnd {
 
+/**
+ * A rotated cell image, cropped to its visible pixels.
+ */
+struct RotatedFrame {
+  olc::Sprite* sprite = nullptr;
+  int off_x = 0, off_y = 0;  // Position relative to the top left of the cell being replaced.
+};
+
+/**
+ * Pre-rotated copies of the cells of a sprite sheet, so an animating tile can be painted
+ * with a plain blit instead of being rotated pixel by pixel every frame.
+ * Sheet column c holds a cell turned c quarter turns, each quarter is split into
+ * 'stepsPerQuarter' intermediate frames. Frames are rendered on first use and kept,
+ * using the engine's rotated blitter, so they must be requested from the engine thread.
+ */
+class RotatedFrameCache : public olc::PGEX {
+
+private:
+  olc::Sprite* sheet;
+  int cell_w, cell_h;
+  int cell_x_cnt, cell_y_cnt;
+  int stepsPerQuarter;
+  std::vector<RotatedFrame*> frames;
+  std::atomic<size_t> bytes { 0 };  // pixels of the frames rendered so far, read by the loaders
+
+public:
+  RotatedFrameCache(olc::Sprite* sheet, const int cell_w, const int cell_h, const int cell_x_cnt,
+      const int cell_y_cnt, const int stepsPerQuarter);
+  ~RotatedFrameCache();
+  RotatedFrameCache(const RotatedFrameCache&) = delete;
+  RotatedFrameCache& operator=(const RotatedFrameCache&) = delete;
+  int getStepCount() {
+    return (this->cell_x_cnt * this->stepsPerQuarter);
+  }
+  RotatedFrame* getFrame(const int row, const int step);
+  size_t getBytes() const {
+    return (this->bytes);
+  }
+
+private:
+  RotatedFrame* renderFrame(const int row, const int step);
+};
+
 class AssetDtls {
 public:
   enum Type {
     SPRITE = 0, AUDIO = 1, LEVEL = 2, SAVED = 3
-  } type;
-  int id;
+  } type = SPRITE;
+  int id = 0;
   std::string name, filePath;
-  int asset_w;
-  int asset_h;
-  int asset_cell_w;
-  int asset_cell_h;
-  int asset_cell_x_cnt;
-  int asset_cell_y_cnt;
-  olc::Sprite* sprite;
-  olc::AudioFile* audio;
-  std::string* rawlevelData;
+  int asset_w = 0;
+  int asset_h = 0;
+  int asset_cell_w = 0;
+  int asset_cell_h = 0;
+  int asset_cell_x_cnt = 0;
+  int asset_cell_y_cnt = 0;
+  olc::Sprite* sprite = nullptr;
+  RotatedFrameCache* rotated = nullptr;
+  olc::AudioFile* audio = nullptr;
+  PackedLevel* levelData = nullptr;  // parsed once at load.
+  void* packData = nullptr;          // a sheet's raw sprite image in the mapped game pack
+  size_t packSize = 0;
+};
+
+const int INF_LOADERS = 4;                       // Most loader threads, fewer on machines with fewer cores.
+const size_t INF_SPRITEBUDGET = 32 * 1024 * 1024;  // Default bytes for decoded sheets and their frames.
+
+/**
+ * How one background load went, times in milliseconds since the registry was made.
+ */
+struct AssetLoadStat {
+  const AssetDtls* asset = nullptr;
+  double start = 0.0, end = 0.0;
+  size_t bytes = 0;  // decoded pixels or packed glyphs
+  bool mapped = false;  // sheet mapped from a raw sprite file, not decoded
+  int worker = -1;
+};
+
+/**
+ * Asset names interned to dense indexes 0, 1, 2... in the order first seen. Lookups hash the
+ * characters where they are, so finding a name builds no strings.
+ */
+class NameTable {
+
+private:
+  std::vector<std::string> names;  // by index
+  std::vector<int> slots;          // open addressed index of names, -1 for empty, a power of two long
+
+public:
+  // The index of name, adding it if new.
+  int intern(const std::string& name);
+  // The index of name, -1 if absent.
+  int find(const char* name, const size_t length) const;
+  int find(const std::string& name) const {
+    return (find(name.data(), name.size()));
+  }
+  const std::string& getName(const int index) const {
+    return (this->names[index]);
+  }
+  int size() const {
+    return (static_cast<int>(this->names.size()));
+  }
+
+private:
+  static uint32_t hash(const char* name, const size_t length);
+  void rehash(const size_t slotCount);
 };
 
+/**
+ * All assets of the resource file, one contiguous vector per type. Sprites, audio and saves are
+ * found by interned name or by index, levels by their 1 based id. The vectors are filled once by the
+ * constructor, so the AssetDtls pointers handed out stay valid for the life of the registry.
+ *
+ * The constructor only reads the resource file, then a pool of loader threads parses the level
+ * layouts. getLevel() waits for its level.
+ *
+ * Sprite sheets are decoded by the loaders when first asked for by getSprite() or prefetchSprite(),
+ * their pixels must be waited for with waitForSprite() or getRotatedFrames(). The rest of a sprite's
+ * details are there at once. Sheets in use are pinned. Whenever a sheet is asked for, finishes
+ * decoding or is unpinned, the least recently used unpinned sheets are freed, with their rotated
+ * frames, until the resident ones fit the budget, a sheet only prefetched included. A sheet being
+ * waited for is held until the wait is over, after that only a pin keeps it, as loaders free sheets
+ * too. A freed sheet is decoded again on its next use. AssetDtls::sprite and ::rotated are only
+ * safe to use while pinned.
+ *
+ * Apart from the loaders, the registry is used from one thread at a time, the one drawing the frames.
+ *
+ * The assets can instead come from a game pack made by compilePack(): one file holding the pack
+ * name, the sheets as raw sprite images and the levels already packed, found through a fixed size
+ * index. The pack is mapped, sheets are drawn from it in place and levels are copied out of it,
+ * nothing is parsed or decoded. Saves are still separate files.
+ */
 class InfinityAssets final {
 
 private:
   //todo allow command line input of different dat file location.
   const std::string m_res_file = "res/infinity-resources.dat";
-  std::map<std::string, AssetDtls*> m_assets;
+  std::vector<AssetDtls> m_sprites, m_audio, m_levels, m_saved;
+  NameTable m_spriteNames, m_audioNames, m_savedNames;  // index alike the vectors
+
+  struct LoadTask {
+    AssetDtls::Type type;
+    int index;           // in the type's vector
+    std::string layout;  // of a level
+  };
+  struct SpriteSlot {
+    enum State {
+      UNLOADED, LOADING, RESIDENT
+    } state = UNLOADED;
+    int pins = 0;
+    uint64_t lastUse = 0;
+  };
+  std::chrono::steady_clock::time_point m_created = std::chrono::steady_clock::now();
+  double m_manifestTime = 0.0;
+  std::unique_ptr<std::atomic<bool>[]> m_levelReady;  // by level index
+
+  // The rest is guarded by m_loadLock.
+  std::mutex m_loadLock;
+  std::condition_variable m_taskReady, m_loadDone;
+  std::deque<LoadTask> m_queue;
+  int m_busy = 0;  // tasks queued or running
+  bool m_stopping = false;
+  std::vector<SpriteSlot> m_spriteSlots;  // by sprite index
+  uint64_t m_useClock = 0;
+  size_t m_spriteBudget = INF_SPRITEBUDGET;
+  std::vector<AssetLoadStat> m_loadStats;
+  std::vector<std::thread> m_loaders;
+
+  void* m_pack = nullptr;  // the mapped game pack, if loaded from one
+  size_t m_packSize = 0;
 
 public:
   int numLevels = 0, numSprites = 0, numAudio = 0;
   std::string pack_name = "TBA";
 
 public:
-  InfinityAssets();
+  // From the game pack if given and valid, otherwise from the resource file.
+  explicit InfinityAssets(const std::string& packFile = "");
   ~InfinityAssets();
   InfinityAssets(const InfinityAssets&) = delete;
   InfinityAssets& operator=(const InfinityAssets&) = delete;
-  AssetDtls* getSprite(const std::string name);
-  AssetDtls* getAudio(const std::string name);
+  // Also starts loading the sheet.
+  AssetDtls* getSprite(const std::string& name);
+  AssetDtls* getSprite(const int index);
+  // Without loading it.
+  const AssetDtls* peekSprite(const int index) const;
+  // The raw sprite file a sheet is converted to, mapped in place of decoding the PNG when present.
+  static std::string getRawSpritePath(const std::string& filePath);
+  AssetDtls* getAudio(const std::string& name);
   AssetDtls* getLevel(const int id);
-  AssetDtls* getSaved(const std::string packName);
+  AssetDtls* getSaved(const std::string& packName);
+  int findSprite(const std::string& name) const {
+    return (this->m_spriteNames.find(name));
+  }
+  // Starts loading the sheet, e.g. for the next level.
+  void prefetchSprite(const int index);
+  // Waits for the sheet's pixels, then returns whether it has any.
+  bool waitForSprite(AssetDtls* ad);
+  // Pinned sheets are never freed.
+  void pinSprite(AssetDtls* ad);
+  void unpinSprite(AssetDtls* ad);
+  void setSpriteBudget(const size_t bytes);
+  size_t getResidentBytes();
+  // Waits for the sheet and makes its frame cache. The frames are only safe to use while the caller
+  // holds a pin on the sheet.
+  RotatedFrameCache* getRotatedFrames(AssetDtls* ad, const int stepsPerQuarter);
+  bool isLoaded();
+  void waitForLoad();
+  // Milliseconds since the registry was made.
+  double getElapsed() const {
+    return (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_created).count());
+  }
+  double getManifestTime() const {
+    return (this->m_manifestTime);
+  }
+  // Every load finished so far.
+  std::vector<AssetLoadStat> getLoadStats();
   bool saveLevel(const AssetDtls* ad, unsigned short levelId);
+  // Writes every asset to a single game pack file.
+  bool compilePack(const std::string& packFile);
+  bool isPacked() const {
+    return (this->m_pack != nullptr);
+  }
 
 private:
   void loadAssets();
+  bool loadPack(const std::string& packFile);
+  void loadSaved(AssetDtls* ad, const std::string& filePath);
+  void startLoaders();
+  void runLoader(const int worker);
+  void requestSprite(const int index);
+  void awaitSprite(std::unique_lock<std::mutex>& lock, const int index);
+  size_t residentBytes() const;
+  void trimSprites();
 };
 
 } // end namespace.
@@ -1,5 +1,10 @@
 #include <cstdlib>
+#include <cmath>
 #include <string>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <atomic>
 
 #include <unistd.h>
 #include <stdio.h>
@@ -7,23 +12,54 @@
 
 #include "olcPixelGameEngine.h"
 #include "smlnd_log.hpp"
+#include "smlnd_trace.hpp"
 #include "infinityassets.hpp"
 #include "InfinityGameLogic.hpp"
 
 using namespace smlnd;
 using namespace olc;
 
+const int INF_FRAMERATE = 60;     // Frame rate cap, the engine idles while nothing animates.
+const float SPLASH_TIME = 2.5f;   // Seconds the splash screen is shown.
+
+/**
+ * Prints how the background asset loads went and when the first frame was drawn, in milliseconds
+ * since the assets were made.
+ */
+static void printStartup(InfinityAssets* assets, const double firstFrame) {
+  const char* types[] = { "sprite", "audio", "level", "saved" };
+  double busy = 0.0, loaded = 0.0;
+  size_t bytes = 0;
+
+  printf("startup (ms):                      worker    start      end     time        bytes\n");
+  for (const AssetLoadStat& stat : assets->getLoadStats()) {
+    printf("  %-6s %-24s %6d %8.2f %8.2f %8.2f %12zu%s\n", types[stat.asset->type], stat.asset->name.c_str(),
+        stat.worker, stat.start, stat.end, stat.end - stat.start, stat.bytes, stat.mapped ? " mapped" : "");
+    busy += stat.end - stat.start;
+    loaded = std::max(loaded, stat.end);
+    bytes += stat.bytes;
+  }
+  printf("  %s read %.2f, all loaded %.2f (%.2f busy, %zu bytes), first frame %.2f\n",
+      assets->isPacked() ? "game pack" : "resource file", assets->getManifestTime(), loaded, busy, bytes, firstFrame);
+  printf("  sprite sheets resident %zu bytes\n", assets->getResidentBytes());
+}
+
 class InfinityGame: public olc::PixelGameEngine {
 
 private:
   InfinityAssets* gameAssets = nullptr;
   AssetDtls* curSprite = nullptr;
+  RotatedFrameCache* curFrames = nullptr;
   Level* curLevel = nullptr;
   InfinityGameLogic* gameLogic = nullptr;
   InfinityRpt statusRpt;
 
   bool showSplash = true;
+  bool animating = false;
   float timeSlice = 0.0f;
+  float fixedStep = 0.0f;  // game seconds per frame, 0 = as measured
+  double firstFrameTime = -1.0;  // ms from the assets being made to the first frame drawn
+  bool startupReported = false;
 
   std::pair<int, int> leftButton[3] = { };
   std::pair<int, int> rightButton[3] = { };
@@ -39,10 +75,22 @@ private:
   unsigned int game_offset_w = 0;
   unsigned int game_offset_h = 0;
 
+  // What is on screen: the banner text it was painted for and each cell's animation step (-1 = not drawn).
+  std::string drawnBanner;
+  std::vector<int> drawnSteps;
+
+  // Board sized layer holding every settled tile composited over the background, and the step each
+  // cell holds in it (-1 = background only, the tile is animating). Rebuilt when a level is loaded.
+  Sprite* boardLayer = nullptr;
+  std::vector<int> layerSteps;
+  // Cell sized scratch for tiles rotated on the fly, which clips them to their cell.
+  Sprite* cellLayer = nullptr;
+
 public:
-  InfinityGame(InfinityAssets* infAssets) {
+  InfinityGame(InfinityAssets* infAssets, bool splash = true) {
     SMLND_DBG_LOG("Inside InfinityGame constructor");
     gameAssets = infAssets;
+    showSplash = splash;
     this->statusRpt = loadGameLevel(1);
     this->SetPixelMode(Pixel::Mode::ALPHA);
     sAppName = "Infinity";
@@ -52,7 +100,8 @@ public:
     SMLND_DBG_LOG_M("loadGameLevel: requested game level to load (id) = ", id);
 
     InfinityRpt report;
-    if (gameAssets->getLevel(id) == nullptr) {
+    AssetDtls* levelAsset = gameAssets->getLevel(id);
+    if (levelAsset == nullptr) {
       SMLND_DBG_LOG_M("loadGameLevel error: no level available for (id) = ", id);
       report.type = InfinityRpt::FATAL;
       report.id = std::to_string(id);
@@ -61,14 +110,14 @@ public:
     }
 
     if (gameLogic == nullptr) {
-      gameLogic = new InfinityGameLogic(gameAssets->getLevel(id)->name,
-          gameAssets->getLevel(id)->rawlevelData->c_str());
+      gameLogic = new InfinityGameLogic(levelAsset->name, *levelAsset->levelData);
     } else {
-      gameLogic->loadNewLevel(id, gameAssets->getLevel(id)->name, gameAssets->getLevel(id)->rawlevelData->c_str());
+      gameLogic->loadNewLevel(id, levelAsset->name, *levelAsset->levelData);
     }
 
     curLevel = gameLogic->level;
-    curSprite = gameAssets->getSprite(curLevel->spriteName);
+    AssetDtls* prevSprite = curSprite;
+    curSprite = gameAssets->getSprite(curLevel->spriteId);
 
     // If selected sprite not available then load 'default'
     if (curSprite == nullptr) {
@@ -79,52 +128,63 @@ public:
       report.msg = "Load level error: no sprite for (id). Loading default";
 
       if (curSprite == nullptr) {
+        gameAssets->unpinSprite(prevSprite);
         report.type = InfinityRpt::Type::FATAL;
         return (report);
       }
     }
 
+    // Keep this level's sheet while it is shown and start decoding the next level's. The sheet may
+    // still be decoding, its frames are fetched when the board is first drawn.
+    gameAssets->pinSprite(curSprite);
+    gameAssets->unpinSprite(prevSprite);
+    AssetDtls* nextLevel = gameAssets->getLevel(id + 1);
+    if (nextLevel != nullptr) gameAssets->prefetchSprite(nextLevel->levelData->spriteId);
+    curFrames = nullptr;
+
     cells_x = curLevel->gridCols;
     cells_y = curLevel->gridRows;
     cell_w = curSprite->asset_cell_w;
     cell_h = curSprite->asset_cell_h;
 
+    // New board and maybe a new sprite sheet: start an empty board layer and repaint the window.
+    delete boardLayer;
+    boardLayer = new Sprite(cells_x * cell_w, cells_y * cell_h);
+    delete cellLayer;
+    cellLayer = new Sprite(cell_w, cell_h);
+    layerSteps.assign(cells_x * cells_y, -1);
+    drawnBanner.clear();
+
     return (report);
   }
 
-  ~InfinityGame() {
-    free(gameAssets);
+  /**
+   * Runs the game as if every frame took the given seconds, e.g. so timed runs animate the same
+   * however fast they render. 0 goes back to real time.
+   */
+  void setFixedStep(const float seconds) {
+    this->fixedStep = seconds;
   }
 
-  // Draws a rotated area of given sprite based on (x,y) coordinates to be the centre painted area.
-  // Rotation is integer based degrees from original.
-  // Selected original sprite area is based on area (ox,oy) to (ox+w,oy+h).
-  // Image area should/needs to be divisible by 2 nicely.  e.g.  32px -> 16px, 31 !-> 15.5???
-  void DrawRotatedPartialSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h,
-      int32_t ang_deg, bool nil_cnrs) {
-    if (sprite == nullptr) return;
-
-    int32_t half_w = w / 2, half_h = h / 2;
-
-    // convert angle deg to radians = angle * (PI/180).
-    float angRad = ang_deg * (3.14159265359 / 180);
-
-    for (int i = -half_w; i < half_w; i++) {
-      for (int j = -half_h; j < half_h; j++) {
-        Pixel pix = sprite->GetPixel((i + half_w) + ox, (j + half_h) + oy);
-        float rotdx = (i * cosf(angRad)) - (j * sinf(angRad));
-        float rotdy = (i * sinf(angRad)) + (j * cosf(angRad));
-
-        // Don't print the corners of image if asked not to.
-        if (nil_cnrs) {
-          if (sqrt((i * i) + (j * j)) <= half_w) Draw(x + rotdx, y + rotdy, pix);
-        } else {
-          Draw(x + rotdx, y + rotdy, pix);
-        }
-      }
+  /**
+   * Prints the startup report once all assets are loaded, waiting for them if asked to.
+   */
+  void reportStartup(const bool wait) {
+    if (this->startupReported) return;
+    if (wait) {
+      gameAssets->waitForLoad();
+    } else if (!gameAssets->isLoaded()) {
+      return;
     }
+    printStartup(gameAssets, this->firstFrameTime);
+    this->startupReported = true;
   }
 
+  ~InfinityGame() {
+    delete boardLayer;
+    delete cellLayer;
+    delete gameAssets;
+  }
 
   // Called once at the start, so create things here
   bool OnUserCreate() override {
@@ -148,27 +208,57 @@ public:
   // called once per frame
   bool OnUserUpdate(float fElapsedTime) override {
 
-    // Calculate the offset of the board to place game in the centre of the window.
+    if (this->fixedStep > 0.0f) fElapsedTime = this->fixedStep;
+    centreBoard();
+    this->ProfileBegin(PROFILE_USER_UPDATE);
+    bool running = userUpdate(fElapsedTime);
+    this->ProfileEnd(PROFILE_USER_UPDATE);
+    if (!running) return (false);
+
+    // The engine idles between inputs, so ask for the frames that animations and the splash need.
+    if (this->showSplash) {
+      this->RequestFrame(std::max(0.0f, SPLASH_TIME - this->timeSlice));
+    } else if (this->animating) {
+      this->RequestFrame();
+    }
+
+    // The update may have loaded a level with a different board size.
+    centreBoard();
+    this->ProfileBegin(PROFILE_USER_DRAW);
+    running = userDraw(fElapsedTime);
+    this->ProfileEnd(PROFILE_USER_DRAW);
+
+    if (this->firstFrameTime < 0.0) this->firstFrameTime = gameAssets->getElapsed();
+    reportStartup(false);
+    return (running);
+  }
+
+  // Calculate the offset of the board to place game in the centre of the window.
+  void centreBoard() {
     this->game_offset_w = (this->ScreenWidth() - (curLevel->gridCols * cell_w)) / 2;
     this->game_offset_h = (this->ScreenHeight() - (curLevel->gridRows * cell_h)) / 2;
-
-    return (userUpdate(fElapsedTime) && userDraw(fElapsedTime));
   }
 
   // called by OnUserUpdate - once per frame
   bool userUpdate(float fElapsedTime) {
+    SMLND_TRACE_SCOPE("userUpdate");
 
     if (this->showSplash) return (true);
 
-    this->gameLogic->update(fElapsedTime);
+    this->animating = this->gameLogic->update(fElapsedTime);
     this->gameLogic->isLevelComplete();
 
     bool goPrev = false, goNext = false;
 
-    // Use integer division to nicely get cursor position in node space
-    if (GetMouse(0).bPressed) {
-      int mouseX = this->GetMouseX();
-      int mouseY = this->GetMouseY();
+    // Every click of this frame is handled where it happened, so fast clicks at a low frame rate
+    // still rotate each tile they hit.
+    InputEvent event;
+    while (this->PollInputEvent(event)) {
+      if (event.type != InputEvent::MOUSE_BUTTON || event.nCode != 0 || !event.bDown) continue;
+
+      // Use integer division to nicely get cursor position in node space
+      int mouseX = event.x;
+      int mouseY = event.y;
       int selectedNodeX = (mouseX - game_offset_w) / cell_w;
       int selectedNodeY = (mouseY - game_offset_h) / cell_h;
 
@@ -179,6 +269,7 @@ public:
 
       // Update / rotate selected cell.. if a valid tile that is.
       this->curLevel->rotateTile(selectedNodeX, selectedNodeY);
+      this->animating = true;
 
       // Check if previous or next buttons were pressed.
       // Just use a circle range from the centre point.
@@ -263,6 +354,11 @@ public:
       }
     }
 
+    // Toggle the frame profiler overlay, when profiling (--profile).
+    if (GetKey(Key::F3).bPressed) {
+      this->ShowProfilerOverlay(!this->IsProfilerOverlayShown());
+    }
+
     // Check if user wants to quit game..
     if (GetKey(Key::Q).bPressed) {
       return (false);
@@ -273,12 +369,13 @@ public:
 
   // called by OnUserUpdate - once per frame
   bool userDraw(float fElapsedTime) {
+    SMLND_TRACE_SCOPE("userDraw");
 
     if (this->showSplash) {
 
       this->timeSlice += fElapsedTime;
 
-      if (this->timeSlice < 2.5f) {
+      if (this->timeSlice < SPLASH_TIME) {
         FillRect((ScreenWidth() / 2) - 130, (ScreenHeight() / 2) - 90, 300, 140, MAGENTA);
         DrawString((ScreenWidth() / 2) - 120, (ScreenHeight() / 2) - 70, "LooP-e", BLACK, 4);
         DrawString((ScreenWidth() / 2) - 110, (ScreenHeight() / 2) - 30, "\"Tie da\"", BLUE, 3);
@@ -290,6 +387,129 @@ public:
     }
 
 
+    // Everything around the board only changes with the level or status, so the window is repainted in
+    // full just when that happens. Other frames only repaint the cells whose animation step moved, which
+    // keeps the engine's dirty region (and so the texture upload) down to those cells.
+    // Rotation steps of INF_ANGLEDELTA are drawn from pre-rotated frames.
+    if (curFrames == nullptr) {
+      curFrames = gameAssets->getRotatedFrames(curSprite, static_cast<int>(INF_ANGLEOFFSET / INF_ANGLEDELTA));
+    }
+
+    std::string banner = std::to_string(curLevel->id) + "|" + gameAssets->pack_name + "|"
+        + std::to_string(gameLogic->levelCleared()) + "|" + std::to_string(gameLogic->isLevelComplete()) + "|"
+        + std::to_string(statusRpt.type) + "|" + statusRpt.msg;
+    bool fullRedraw = (banner != this->drawnBanner);
+    if (fullRedraw) {
+      this->drawnBanner = banner;
+      drawBanner();
+
+      // The settled tiles come straight from the board layer, only animating ones are left to draw.
+      this->SetPixelMode(Pixel::Mode::NORMAL);
+      this->DrawSprite(game_offset_w, game_offset_h, boardLayer);
+      this->SetPixelMode(Pixel::Mode::ALPHA);
+      this->drawnSteps = this->layerSteps;
+    }
+
+    // Only tiles that are turning, or just stopped, can have moved since the last frame.
+    CellGrid& cells = curLevel->getGameCells();
+    if (fullRedraw) {
+      for (GameCell& cell : cells) drawCell(cell);
+    } else {
+      for (int index : curLevel->getSettledCells()) drawCell(cells[index]);
+      for (int index : curLevel->getAnimatingCells()) drawCell(cells[index]);
+    }
+
+    return (true);
+  }
+
+  /**
+   * Brings one cell up to date in the board layer and on screen, if its animation step moved.
+   */
+  void drawCell(GameCell& cell) {
+
+    // Don't process if a blank cell.
+    if (cell.glyph == smlnd::BLNK) return;
+
+    int glyphTypeIndex = static_cast<int>(cell.glyph);
+    unsigned int xPos = (cell.x * cell_w) + game_offset_w;
+    unsigned int yPos = (cell.y * cell_h) + game_offset_h;
+
+    // Nearest animation step, 0 to 360 degrees. Quarter turns sit on the sprite sheet as is.
+    int stepsPerQuarter = curFrames->getStepCount() / INF_EDGES;
+    int step = cell.getCellStep(stepsPerQuarter);
+
+    // Settled tiles are composited into the board layer once, animating ones leave it blank.
+    int cellIndex = cell.y * cells_x + cell.x;
+    bool settled = (step % stepsPerQuarter == 0);
+    int& layerStep = this->layerSteps[cellIndex];
+    if (layerStep != (settled ? step : -1)) {
+      layerStep = settled ? step : -1;
+      updateBoardLayer(cell.x, cell.y, glyphTypeIndex, step / stepsPerQuarter, settled);
+    }
+
+    // A cell is repainted on its own: restored from the board layer, with the animating tile drawn
+    // over it clipped to the cell, as nothing outside it is restored.
+    int& drawnStep = this->drawnSteps[cellIndex];
+    if (drawnStep == step) return;
+    drawnStep = step;
+
+    this->SetPixelMode(Pixel::Mode::NORMAL);
+    this->DrawPartialSprite(xPos, yPos, boardLayer, cell.x * cell_w, cell.y * cell_h, cell_w, cell_h);
+    this->SetPixelMode(Pixel::Mode::ALPHA);
+
+    if (!settled) {
+
+      // Paint the pre-rotated frame over the cell, or rotate the leaving quarter turn cell
+      // directly when the angle is not one of the cached steps. Round artwork fits the cell at
+      // any angle, the corners of square artwork are cut off.
+      RotatedFrame* frame = curFrames->getFrame(glyphTypeIndex, step);
+      if (frame != nullptr) {
+        int fx = std::max(0, -frame->off_x);
+        int fy = std::max(0, -frame->off_y);
+        int fw = std::min(frame->sprite->width, cell_w - frame->off_x) - fx;
+        int fh = std::min(frame->sprite->height, cell_h - frame->off_y) - fy;
+        if (fw > 0 && fh > 0) {
+          this->DrawPartialSprite(xPos + frame->off_x + fx, yPos + frame->off_y + fy, frame->sprite, fx, fy, fw,
+              fh);
+        }
+      } else {
+        int glyphRotnIndex = step / stepsPerQuarter;
+        this->SetDrawTarget(cellLayer);
+        this->SetPixelMode(Pixel::Mode::NORMAL);
+        this->Clear(BLANK);
+        this->DrawRotatedPartialSprite(cell_w / 2, cell_h / 2, curSprite->sprite, glyphRotnIndex * cell_w,
+            glyphTypeIndex * cell_h, cell_w, cell_h, cell.getCellRotation() - glyphRotnIndex * INF_ANGLEOFFSET);
+        this->SetDrawTarget(nullptr);
+        this->SetPixelMode(Pixel::Mode::ALPHA);
+        this->DrawSprite(xPos, yPos, cellLayer);
+      }
+    }
+  }
+
+  /**
+   * Repaints one cell of the board layer: the background, then the tile at the given quarter turn
+   * if it has settled there.
+   */
+  void updateBoardLayer(const int x, const int y, const int glyphTypeIndex, const int glyphRotnIndex,
+      const bool settled) {
+
+    this->SetDrawTarget(boardLayer);
+    this->SetPixelMode(Pixel::Mode::NORMAL);
+    this->FillRect(x * cell_w, y * cell_h, cell_w, cell_h, BLACK);
+    this->SetPixelMode(Pixel::Mode::ALPHA);
+    if (settled) {
+      this->DrawPartialSprite(x * cell_w, y * cell_h, curSprite->sprite, glyphRotnIndex * cell_w,
+          glyphTypeIndex * cell_h, cell_w, cell_h);
+    }
+    this->SetDrawTarget(nullptr);
+  }
+
+  /**
+   * Clears the window and paints everything around the board: level title, status, key help and the
+   * previous / next buttons.
+   */
+  void drawBanner() {
+
     // Clear screen and render title of the level.
     this->Clear(BLACK);
     this->DrawString(10, 10, "Level(" + std::to_string(curLevel->id) + "): " + gameLogic->level->name, YELLOW, 2);
@@ -323,59 +543,419 @@ public:
       this->FillTriangle(rightButton[0].first, rightButton[0].second, rightButton[1].first, rightButton[1].second,
           rightButton[2].first, rightButton[2].second, WHITE);
     }
+  }
+
+};
 
-    std::map<std::pair<int, int>, GameCell*> cells = curLevel->getGameCells();
-    for (auto& obj : curLevel->getGameCells()) {
+/**
+ * Checks each alpha blend kernel available on this CPU against the scalar reference
+ * on random spans of every tail length, then reports its throughput.
+ * Returns false if any kernel differs from the reference.
+ */
+static bool benchBlend() {
+  const char* names[] = { "scalar", "sse2", "avx2" };
+  const int32_t spanLen = 1024;
+  std::vector<Pixel> src(spanLen), dst(spanLen), ref(spanLen), out(spanLen);
+
+  srand(1);
+  for (int32_t i = 0; i < spanLen; i++) {
+    src[i].n = (static_cast<uint32_t>(rand()) << 16) ^ rand();
+    dst[i].n = (static_cast<uint32_t>(rand()) << 16) ^ rand();
+  }
 
-      // Don't process if a blank cell.
-      if (obj.second->glyph == smlnd::BLNK) continue;
+  BlendSpanFunc scalar = GetBlendSpanKernel(BLEND_SCALAR);
+  bool ok = true;
+
+  for (int k = BLEND_SCALAR; k <= BLEND_AVX2; k++) {
+    BlendSpanFunc kernel = GetBlendSpanKernel(static_cast<BlendKernel>(k));
+    if (kernel == nullptr) {
+      printf("blend %-6s: not available\n", names[k]);
+      continue;
+    }
 
-      int glyphTypeIndex = static_cast<int>(obj.second->glyph);
-      float cellRotation = obj.second->getCellRotation();
-      int cellRotIndex = ((int) (cellRotation) % 360); // I'm ignoring any small decimals close to quadrants e.g. 360.5, 299.5.
-      unsigned int xPos = (obj.second->x * cell_w) + game_offset_w;
-      unsigned int yPos = (obj.second->y * cell_h) + game_offset_h;
-      int glyphRotnIndex = 0;
+    // Correctness: every span length up to 67 covers all vector tails, at several blend factors.
+    bool same = true;
+    for (int blend : { 0, 1, 128, 254, 255 }) {
+      for (int32_t n = 0; n <= 67; n++) {
+        ref = dst;
+        out = dst;
+        scalar(ref.data(), src.data() + 3, n, blend);
+        kernel(out.data(), src.data() + 3, n, blend);
+        same = same && std::equal(ref.begin(), ref.end(), out.begin(),
+            [](const Pixel& a, const Pixel& b) { return (a.n == b.n); });
+      }
+    }
+    ok = ok && same;
+
+    // Throughput: blend a span repeatedly over the same destination.
+    const int reps = 20000;
+    auto tp1 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++)
+      kernel(out.data(), src.data(), spanLen, 200);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - tp1;
+    printf("blend %-6s: %s, %.0f Mpx/s\n", names[k], same ? "matches scalar" : "MISMATCH",
+        (double) reps * spanLen / elapsed.count() / 1e6);
+  }
+  return (ok);
+}
 
-      if (cellRotIndex == 0 || cellRotIndex == 90 || cellRotIndex == 180 || cellRotIndex == 270) {
+/**
+ * Builds a solved level of the given size: random links between neighbours, each cell the glyph with
+ * those connectors. Tiles start at random angles, so they are then turned into place.
+ */
+static InfinityGameLogic* makeSolvedLevel(const int cols, const int rows) {
+  std::vector<uint8_t> want(static_cast<size_t>(cols) * rows, 0);
+  for (int y = 0; y < rows; y++) {
+    for (int x = 0; x < cols; x++) {
+      uint8_t& cell = want[y * cols + x];
+      if (x + 1 < cols && rand() % 2) { cell |= C_E; want[y * cols + x + 1] |= C_W; }
+      if (y + 1 < rows && rand() % 2) { cell |= C_S; want[(y + 1) * cols + x] |= C_N; }
+    }
+  }
 
-        // Paint available set images variants from the sprite sheet without alteration.
-        glyphRotnIndex = (int) (cellRotIndex) / INF_ANGLEOFFSET;
-        this->DrawPartialSprite(xPos, yPos, curSprite->sprite, glyphRotnIndex * cell_w, glyphTypeIndex * cell_h, cell_w,
-            cell_h);
+  // Every mask is one of the glyphs turned some number of quarters.
+  PackedLevel layout("bench", cols, rows);
+  for (int i = 0; i < layout.size(); i++) {
+    uint8_t mask = want[i];
+    int count = ((mask >> 0) & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+    if (count == 1) layout.setGlyph(i, LEND);
+    else if (count == 2) layout.setGlyph(i, (mask == (C_N | C_S) || mask == (C_E | C_W)) ? SBAR : SARC);
+    else if (count == 3) layout.setGlyph(i, TRIO);
+    else if (count == 4) layout.setGlyph(i, QUAD);
+  }
+  InfinityGameLogic* logic = new InfinityGameLogic("bench", layout);
+  Level* level = logic->level;
 
-      } else {
+  for (int turn = 0; turn < INF_EDGES; turn++) {
+    for (GameCell& cell : level->getGameCells()) {
+      if (cell.getConnectors() != want[cell.y * cols + cell.x]) level->rotateTile(cell.x, cell.y);
+    }
+    while (level->update(INF_TURNTIME)) {
+    }
+  }
+  return (logic);
+}
 
-        // Paint rotated cell relative to the centre of the image.
-        float origAngleIndex = 0;
-        if (cellRotIndex > 270) {
-          origAngleIndex = 270;
-        } else if (cellRotIndex > 180) {
-          origAngleIndex = 180;
-        } else if (cellRotIndex > 90) {
-          origAngleIndex = 90;
-        }
+/**
+ * Times full scans for level completion on solved boards from 10x10 to 2000x2000, where every
+ * connector has to be looked at: cell by cell, and a row of bit planes at a time. Returns false if
+ * they disagree with each other or with the level's running count of unmatched pairs.
+ */
+static bool benchLogic() {
+  srand(1);
+  bool ok = true;
+  for (int size : { 10, 100, 500, 1000, 2000 }) {
+    InfinityGameLogic* logic = makeSolvedLevel(size, size);
+    Level* level = logic->level;
+    int reps = std::max(2, 20000000 / (size * size));
+    Arena arena;
+    ConnectorRows rows(arena);
+    level->fillConnectorRows(rows);
+
+    bool byCell = true, byRow = true;
+    auto tp1 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++)
+      byCell = level->scanComplete() && byCell;
+    auto tp2 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++)
+      byRow = rows.isClosed() && byRow;
+    auto tp3 = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::micro> cellTime = (tp2 - tp1) / reps, rowTime = (tp3 - tp2) / reps;
+    printf("complete %4dx%-4d: by cell %10.1f us, by row %8.1f us, %5.1fx %s\n", size, size, cellTime.count(),
+        rowTime.count(), cellTime.count() / rowTime.count(), (byCell && byRow) ? "" : "NOT SOLVED");
+    ok = ok && byCell && byRow && (level->getUnmatched() == 0);
+
+    // One turned tile has to be caught by both.
+    level->rotateTile(size / 2, size / 2);
+    while (level->update(INF_TURNTIME)) {
+    }
+    GameCell& cell = level->getGameCells().at(size / 2, size / 2);
+    bool changed = (cell.glyph != BLNK && cell.glyph != QUAD && cell.glyph != DARC);
+    level->fillConnectorRows(rows);
+    ok = ok && (level->scanComplete() == !changed) && (rows.isClosed() == !changed)
+        && ((level->getUnmatched() == 0) == !changed);
+    delete logic;
+  }
+  return (ok);
+}
+
+#ifdef INF_COUNT_ALLOCS
+// "make ALLOCS=1" counts every operator new, for the allocation reports.
+static std::atomic<uint64_t> heapAllocations(0);
+
+void* operator new(size_t size) {
+  heapAllocations++;
+  void* memory = malloc(size);
+  if (memory == nullptr) throw std::bad_alloc();
+  return (memory);
+}
+
+void operator delete(void* memory) noexcept {
+  free(memory);
+}
+
+static uint64_t getHeapAllocations() {
+  return (heapAllocations);
+}
+#else
+static uint64_t getHeapAllocations() {
+  return (0);
+}
+#endif
+
+/**
+ * Switches through every level of the pack a number of times, the way the N/P keys do, and
+ * reports the time and allocations one switch costs. Heap allocations are only counted in builds
+ * made with ALLOCS=1.
+ */
+static bool benchLevels(InfinityAssets* assets) {
+  if (assets->getLevel(1) == nullptr) return (false);
+
+  InfinityGameLogic logic(assets->getLevel(1)->name, *assets->getLevel(1)->levelData);
+  const int rounds = 200;
+  int switches = 0;
+
+  Arena::Stats before = logic.getArena().getStats();
+  uint64_t heapBefore = getHeapAllocations();
+  auto tp1 = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (int id = 1; assets->getLevel(id) != nullptr; id++, switches++)
+      logic.loadNewLevel(id, assets->getLevel(id)->name, *assets->getLevel(id)->levelData);
+  }
+  std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - tp1;
+  const Arena::Stats& after = logic.getArena().getStats();
+
+  printf("level switch: %.1f us, %.1f arena allocations (%.0f bytes), %.3f arena blocks, %.1f heap allocations\n",
+      elapsed.count() / switches, double(after.allocations - before.allocations) / switches,
+      double(after.bytes - before.bytes) / switches, double(after.blocks - before.blocks) / switches,
+      double(getHeapAllocations() - heapBefore) / switches);
+  printf("level arena: %zu bytes in use of %zu\n", logic.getArena().getUsed(), logic.getArena().getCapacity());
+  return (true);
+}
+
+/**
+ * The forward mapped rotation animating tiles were drawn with before the pre-rotated frames and the
+ * engine's DrawRotatedPartialSprite, kept as the reference for "--bench-rotate". Each source pixel
+ * is turned onto the target, so some target pixels are missed.
+ */
+static void drawRotatedForward(PixelGameEngine& pge, int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy,
+    int32_t w, int32_t h, float ang_deg) {
+  int32_t half_w = w / 2, half_h = h / 2;
+
+  // convert angle deg to radians = angle * (PI/180).
+  float angRad = ang_deg * (3.14159265359 / 180);
+
+  for (int i = -half_w; i < half_w; i++) {
+    for (int j = -half_h; j < half_h; j++) {
+      Pixel pix = sprite->GetPixel((i + half_w) + ox, (j + half_h) + oy);
+      float rotdx = (i * cosf(angRad)) - (j * sinf(angRad));
+      float rotdy = (i * sinf(angRad)) + (j * cosf(angRad));
+      pge.Draw(x + rotdx, y + rotdy, pix);
+    }
+  }
+}
 
-        // the closest partial image offset to rotate.
-        glyphRotnIndex = (int) (origAngleIndex) / INF_ANGLEOFFSET;
-        // the rotation angle in degrees relative to the nearest/leaving partial image.
-        float deltaAngle = (int) (cellRotation) % 360 + (cellRotation - (int) (cellRotation)) - origAngleIndex;
+/**
+ * Draws every animation step of every tile of the default (64px) and duplo (128px) sheets with the
+ * forward mapped reference, the engine's DrawRotatedPartialSprite and the pre-rotated frames, and
+ * reports the time per tile. The engine's output is checked against a floating point inverse map,
+ * the frames against the engine's output.
+ */
+static bool benchRotate(InfinityAssets* assets) {
+  PixelGameEngine engine;
+  if (engine.Construct(64, 64, 1, 1) != olc::OK) return (false);
+  const int stepsPerQuarter = static_cast<int>(INF_ANGLEOFFSET / INF_ANGLEDELTA);
+  bool ok = true;
+
+  for (const char* name : { "default", "duplo" }) {
+    AssetDtls* ad = assets->getSprite(name);
+    assets->pinSprite(ad);
+    if (ad == nullptr || !assets->waitForSprite(ad)) {
+      printf("rotate %s: sheet not available\n", name);
+      assets->unpinSprite(ad);
+      ok = false;
+      continue;
+    }
+    Sprite* sheet = ad->sprite;
+    int cell_w = ad->asset_cell_w, cell_h = ad->asset_cell_h;
+    RotatedFrameCache cache(sheet, cell_w, cell_h, ad->asset_cell_x_cnt, ad->asset_cell_y_cnt, stepsPerQuarter);
+
+    // A target the size of the frames' bound, the cell in its centre.
+    int diag = static_cast<int>(ceil(sqrt(cell_w * cell_w + cell_h * cell_h)));
+    int bound_w = diag + ((diag - cell_w) & 1), bound_h = diag + ((diag - cell_h) & 1);
+    int cell_x = (bound_w - cell_w) / 2, cell_y = (bound_h - cell_h) / 2;
+    Sprite target(bound_w, bound_h), frames(bound_w, bound_h), forward(bound_w, bound_h);
+
+    // Every step off the quarter turns, the ones drawn while a tile animates.
+    struct Tile {
+      int row, step, ox, oy;
+      float angle;
+    };
+    std::vector<Tile> tiles;
+    for (int row = 0; row < ad->asset_cell_y_cnt; row++) {
+      for (int step = 0; step < cache.getStepCount(); step++) {
+        if (step % stepsPerQuarter == 0) continue;
+        tiles.push_back(Tile { row, step, (step / stepsPerQuarter) * cell_w, row * cell_h,
+            (step % stepsPerQuarter) * (90.0f / stepsPerQuarter) });
+      }
+    }
 
-        this->DrawRotatedPartialSprite(xPos + cell_w / 2, yPos + cell_h / 2, curSprite->sprite, glyphRotnIndex * cell_w,
-            glyphTypeIndex * cell_h, cell_w, cell_h, deltaAngle, false);
+    // Correctness, drawn over a blank target.
+    long offReference = 0, offFrames = 0, holes = 0;
+    engine.SetPixelMode(Pixel::NORMAL);
+    for (const Tile& tile : tiles) {
+      engine.SetDrawTarget(&target);
+      engine.Clear(olc::BLANK);
+      engine.DrawRotatedPartialSprite(bound_w / 2, bound_h / 2, sheet, tile.ox, tile.oy, cell_w, cell_h, tile.angle);
+      RotatedFrame* frame = cache.getFrame(tile.row, tile.step);
+      engine.SetDrawTarget(&frames);
+      engine.Clear(olc::BLANK);
+      engine.DrawSprite(cell_x + frame->off_x, cell_y + frame->off_y, frame->sprite);
+      engine.SetDrawTarget(&forward);
+      engine.Clear(olc::BLANK);
+      drawRotatedForward(engine, bound_w / 2, bound_h / 2, sheet, tile.ox, tile.oy, cell_w, cell_h, tile.angle);
+
+      float rad = tile.angle * 0.01745329252f, c = cosf(rad), s = sinf(rad);
+      for (int y = 0; y < bound_h; y++) {
+        for (int x = 0; x < bound_w; x++) {
+          float fu = x + 0.5f - bound_w / 2, fv = y + 0.5f - bound_h / 2;
+          float u = fu * c + fv * s + 0.5f * cell_w, v = fv * c - fu * s + 0.5f * cell_h;
+          Pixel want = (u >= 0 && u < cell_w && v >= 0 && v < cell_h) ?
+              sheet->GetPixel(tile.ox + static_cast<int>(u), tile.oy + static_cast<int>(v)) : olc::BLANK;
+          Pixel got = target.GetPixel(x, y);
+          if (got.n != want.n) offReference++;
+          if (got.n != frames.GetPixel(x, y).n) offFrames++;
+          if (got.a != 0 && forward.GetPixel(x, y).a == 0) holes++;
+        }
       }
-    } // end for loop.
-    
-    return (true);
+    }
+    // 16.16 fixed point may land a pixel centre on the other side of a source edge now and then.
+    bool same = offReference * 1000 <= static_cast<long>(tiles.size()) * bound_w * bound_h && offFrames == 0;
+    ok = ok && same;
+
+    // Throughput, blending over an opaque target the way the game draws.
+    engine.SetDrawTarget(&target);
+    engine.SetPixelMode(Pixel::ALPHA);
+    const int reps = 3;
+    double times[3];
+    for (int k = 0; k < 3; k++) {
+      engine.Clear(olc::DARK_GREY);
+      auto tp1 = std::chrono::steady_clock::now();
+      for (int r = 0; r < reps; r++) {
+        for (const Tile& tile : tiles) {
+          if (k == 0) {
+            drawRotatedForward(engine, bound_w / 2, bound_h / 2, sheet, tile.ox, tile.oy, cell_w, cell_h, tile.angle);
+          } else if (k == 1) {
+            engine.DrawRotatedPartialSprite(bound_w / 2, bound_h / 2, sheet, tile.ox, tile.oy, cell_w, cell_h,
+                tile.angle);
+          } else {
+            RotatedFrame* frame = cache.getFrame(tile.row, tile.step);
+            engine.DrawSprite(cell_x + frame->off_x, cell_y + frame->off_y, frame->sprite);
+          }
+        }
+      }
+      std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - tp1;
+      times[k] = elapsed.count() / (reps * tiles.size());
+    }
+    engine.SetDrawTarget(nullptr);
+    assets->unpinSprite(ad);
+
+    printf("rotate %3dpx: forward %.1f us, inverse %.1f us, cached %.1f us per tile\n", cell_w, times[0], times[1],
+        times[2]);
+    printf("rotate %3dpx: inverse %s (%.2f px per tile off the reference), frames %s, forward leaves %.1f holes\n",
+        cell_w, same ? "matches" : "MISMATCH", double(offReference) / tiles.size(),
+        offFrames == 0 ? "match" : "MISMATCH", double(holes) / tiles.size());
   }
+  return (ok);
+}
 
-};
+/**
+ * Writes each sheet of the resource file as a raw sprite file, see InfinityAssets::getRawSpritePath(),
+ * which the loaders then map instead of decoding the PNG.
+ */
+static bool convertSprites(InfinityAssets* assets) {
+  bool ok = true;
+  for (int i = 0; assets->peekSprite(i) != nullptr; i++) {
+    const AssetDtls* ad = assets->peekSprite(i);
+    std::string rawPath = InfinityAssets::getRawSpritePath(ad->filePath);
+
+    olc::Sprite sheet;
+    if (sheet.LoadFromFile(ad->filePath) != olc::OK) {
+      printf("convert: can't decode %s\n", ad->filePath.c_str());
+      ok = false;
+      continue;
+    }
+    sheet.cellWidth = ad->asset_cell_w;
+    sheet.cellHeight = ad->asset_cell_h;
+    if (sheet.SaveToSprFile(rawPath) != olc::OK) {
+      printf("convert: can't write %s\n", rawPath.c_str());
+      ok = false;
+      continue;
+    }
+    printf("convert: %s -> %s, %d x %d\n", ad->filePath.c_str(), rawPath.c_str(), sheet.width, sheet.height);
+  }
+  return (ok);
+}
+
+/**
+ * Returns the value following the named option anywhere on the command line, or "" if absent.
+ */
+static std::string getOption(int argc, char **argv, const std::string& name) {
+  for (int i = 1; i + 1 < argc; i++) {
+    if (name == argv[i]) return (argv[i + 1]);
+  }
+  return ("");
+}
+
+/**
+ * Returns true if the named flag is anywhere on the command line.
+ */
+static bool hasOption(int argc, char **argv, const std::string& name) {
+  for (int i = 1; i < argc; i++) {
+    if (name == argv[i]) return (true);
+  }
+  return (false);
+}
+
+/**
+ * Prints the per-phase frame timings collected by the engine's profiler.
+ */
+static void printProfile(FrameProfiler* profiler) {
+  if (profiler == nullptr) return;
+  printf("profile over the last %u frames (ms):      min      avg      p99\n",
+      std::min(profiler->GetFrameCount(), 256u));
+  for (int p = 0; p < PROFILE_PHASES; p++) {
+    FrameProfiler::Stats stats = profiler->GetStats(static_cast<ProfilePhase>(p));
+    printf("  %-38s %8.3f %8.3f %8.3f\n", FrameProfiler::GetPhaseName(static_cast<ProfilePhase>(p)),
+        stats.fMin / 1000.0f, stats.fAvg / 1000.0f, stats.fP99 / 1000.0f);
+  }
+
+  const PerfCounterGroup& counters = profiler->GetCounters();
+  if (!counters.IsOpen()) return;
+  printf("hardware counters, mean per frame (k):  cycles   instr   IPC  L1d miss  LLC miss  br miss\n");
+  for (int p = 0; p < PROFILE_PHASES; p++) {
+    ProfilePhase phase = static_cast<ProfilePhase>(p);
+    double cycles = profiler->GetCounterAvg(phase, PERF_CYCLES);
+    double instructions = profiler->GetCounterAvg(phase, PERF_INSTRUCTIONS);
+    printf("  %-34s %8.1f %7.1f %5.2f %9.2f %9.2f %8.2f\n", FrameProfiler::GetPhaseName(phase),
+        cycles / 1000.0, instructions / 1000.0, (cycles > 0.0) ? instructions / cycles : 0.0,
+        profiler->GetCounterAvg(phase, PERF_L1D_MISSES) / 1000.0,
+        profiler->GetCounterAvg(phase, PERF_LLC_MISSES) / 1000.0,
+        profiler->GetCounterAvg(phase, PERF_BRANCH_MISSES) / 1000.0);
+  }
+  for (int c = 0; c < PERF_COUNTERS; c++) {
+    if (!counters.IsAvailable(static_cast<PerfCounter>(c)))
+      printf("  (%s not available on this system)\n", PerfCounterGroup::GetCounterName(static_cast<PerfCounter>(c)));
+  }
+}
 
 /**
  * Main function.
  */
 int main(int argc, char **argv) {
 
+  SMLND_TRACE_THREAD("main");
   SMLND_DBG_LOG("Inside main before InfinityAssets created");
 
   printf("argc = %d\n", argc);
@@ -388,15 +968,105 @@ int main(int argc, char **argv) {
     SMLND_DBG_LOG_M("Current working dir:", cwd);
   }
 
-  InfinityAssets* gameAssets = new InfinityAssets();
+  // Check and time the alpha blend kernels, e.g. "--bench-blend".
+  if (argc > 1 && std::string(argv[1]) == "--bench-blend") {
+    return (benchBlend() ? 0 : 1);
+  }
+
+  // Check and time the level completion check, e.g. "--bench-logic".
+  if (argc > 1 && std::string(argv[1]) == "--bench-logic") {
+    return (benchLogic() ? 0 : 1);
+  }
+
+  // Assets come from the game pack given with "--pack <file>", otherwise from the resource file.
+  InfinityAssets* gameAssets = new InfinityAssets(getOption(argc, argv, "--pack"));
+
+  // Sheets are freed least recently used first once over this many MiB, "--sprite-budget <MiB>".
+  std::string spriteBudget = getOption(argc, argv, "--sprite-budget");
+  if (!spriteBudget.empty()) gameAssets->setSpriteBudget(static_cast<size_t>(atof(spriteBudget.c_str()) * 1024 * 1024));
+
+  // Convert the PNG sprite sheets to raw sprite files, "--convert-sprites".
+  if (argc > 1 && std::string(argv[1]) == "--convert-sprites") {
+    return (convertSprites(gameAssets) ? 0 : 1);
+  }
+
+  // Bundle every asset into one game pack, "--compile-pack <file>".
+  std::string packFile = getOption(argc, argv, "--compile-pack");
+  if (!packFile.empty()) {
+    return (gameAssets->compilePack(packFile) ? 0 : 1);
+  }
+
+  // Check and time tile rotation, forward mapped, inverse mapped and cached, e.g. "--bench-rotate".
+  if (argc > 1 && std::string(argv[1]) == "--bench-rotate") {
+    return (benchRotate(gameAssets) ? 0 : 1);
+  }
+
+  // Time and count the allocations of switching levels, e.g. "--bench-levels".
+  if (argc > 1 && std::string(argv[1]) == "--bench-levels") {
+    return (benchLevels(gameAssets) ? 0 : 1);
+  }
+
+  // Per frame phase timings are written to the file given with "--profile <file.csv>", F3 shows
+  // them in game.
+  std::string profileFile = getOption(argc, argv, "--profile");
+  // "--counters" adds cycles, instructions, cache and branch misses per phase (Linux perf events).
+  bool profileCounters = hasOption(argc, argv, "--counters");
+  bool profile = !profileFile.empty() || profileCounters;
+
+  // Builds made with TRACE=1 write a Chrome trace_event timeline on exit, to "--trace <file.json>"
+  // or infinity-trace.json. Open it in Perfetto or chrome://tracing.
+  std::string traceFile = getOption(argc, argv, "--trace");
+  if (traceFile.empty()) traceFile = "infinity-trace.json";
+
+  // Headless run for timing the renderer without a display, e.g. "--headless 2000 9"
+  // renders 2000 frames of level 9 in memory and reports the frame rate. Animations advance as at
+  // INF_FRAMERATE, so every run draws the same frames.
+  if (argc > 2 && std::string(argv[1]) == "--headless") {
+    unsigned int frames = std::max(atoi(argv[2]), 1);
+    int level = (argc > 3 && argv[3][0] != '-') ? atoi(argv[3]) : 1;
+
+    InfinityGame gameEngine(gameAssets, false);
+    gameEngine.setFixedStep(1.0f / INF_FRAMERATE);
+    Platform_Null platform(frames);
+
+    // Script: step forward to the requested level, then keep clicking around the window
+    // so there are always several tiles animating.
+    unsigned int frame = 0;
+    for (int i = 1; i < level; i++, frame += 2) platform.PushKeyStroke(frame, Key::N);
+    for (unsigned int n = 0; frame < frames; frame += 2, n++)
+      platform.PushClick(frame, 64 + (n * 67) % 1152, 64 + (n * 61) % 762);
+
+    gameEngine.SetPlatform(&platform);
+    if (profile) gameEngine.EnableProfiler(true, profileFile, profileCounters);
+    if (gameEngine.Construct(1280, 890, 1, 1)) {
+      auto tp1 = std::chrono::steady_clock::now();
+      gameEngine.Start();
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - tp1;
+      printf("headless: %u frames in %.3f s = %.1f FPS, %.1f KB presented per frame\n", platform.GetFrameCount(),
+          elapsed.count(), platform.GetFrameCount() / elapsed.count(),
+          platform.GetPresentedBytes() / 1024.0 / std::max(platform.GetFrameCount(), 1u));
+      gameEngine.reportStartup(true);
+      printProfile(gameEngine.GetProfiler());
+      if (gameEngine.GetDroppedInputEvents() > 0)
+        printf("input: %u events dropped, the queue was full\n", gameEngine.GetDroppedInputEvents());
+    }
+    SMLND_TRACE_DUMP(traceFile);
+    return (0);
+  }
+
   InfinityGame gameEngine(gameAssets);
 
   SMLND_DBG_LOG("Inside main after InfinityAssets created");
 
-  if (gameEngine.Construct(1280, 890, 1, 1)) {  // request 25 FPS
+  if (profile) gameEngine.EnableProfiler(true, profileFile, profileCounters);
+  if (gameEngine.Construct(1280, 890, 1, 1, INF_FRAMERATE)) {
+    gameEngine.SetIdleMode(true);
     gameEngine.Start();
+    if (gameEngine.GetDroppedInputEvents() > 0)
+      printf("input: %u events dropped, the queue was full\n", gameEngine.GetDroppedInputEvents());
   }
 
+  SMLND_TRACE_DUMP(traceFile);
   return (0);
 }
 
@@ -129,6 +129,24 @@
  */
 
 #include "olcPixelGameEngine.h"
+#include "smlnd_trace.hpp"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 
 namespace olc {
@@ -155,7 +173,8 @@ Sprite::Sprite() {
 }
 
 Sprite::Sprite(std::string sImageFile) {
-  LoadFromFile(sImageFile);
+  if (LoadFromSprFile(sImageFile) != olc::OK)
+    LoadFromFile(sImageFile);
 }
 
 Sprite::Sprite(int32_t w, int32_t h) {
@@ -169,15 +188,126 @@ Sprite::Sprite(int32_t w, int32_t h) {
 }
 
 Sprite::~Sprite() {
+  olc_Release();
+}
+
+void Sprite::olc_Release() {
+  if (bBorrowed) {
+    bBorrowed = false;
+    pColData = nullptr;
+  }
+#ifndef _WIN32
+  if (pMapping) {
+    munmap(pMapping, nMappingSize);
+    pMapping = nullptr;
+    pColData = nullptr;
+  }
+#endif
   if (pColData)
     delete[] pColData;
+  pColData = nullptr;
 }
 
+// Sprite file: this header, then height rows of width Pixels (r, g, b, a bytes, straight alpha)
+// from nDataOffset. Header fields are in host byte order.
+struct SprFileHeader {
+  char sMagic[4];          // "OLCS"
+  uint32_t nVersion;       // 1
+  int32_t nWidth, nHeight;
+  int32_t nCellWidth, nCellHeight;
+  uint32_t nFlags;         // None defined yet, files with any set are refused
+  uint32_t nDataOffset;    // A multiple of 16, so mapped rows suit the SIMD blends
+};
+static const char sSprMagic[4] = { 'O', 'L', 'C', 'S' };
+static const int32_t nSprMaxSide = 16384;
+
 olc::rcode Sprite::LoadFromSprFile(std::string sImageFile) {
+#ifdef _WIN32
   return olc::FAIL;
+#else
+  int fd = open(sImageFile.c_str(), O_RDONLY);
+  if (fd < 0)
+    return olc::NO_FILE;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(SprFileHeader)) {
+    close(fd);
+    return olc::FAIL;
+  }
+
+  // Private mapping, so drawing on the sprite copies the touched pages instead of writing the file
+  size_t nSize = (size_t) st.st_size;
+  void *pMap = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (pMap == MAP_FAILED)
+    return olc::FAIL;
+
+  if (LoadFromSprMemory(pMap, nSize) != olc::OK) {
+    munmap(pMap, nSize);
+    return olc::FAIL;
+  }
+  bBorrowed = false;
+  pMapping = pMap;
+  nMappingSize = nSize;
+  return olc::OK;
+#endif
+}
+
+olc::rcode Sprite::LoadFromSprMemory(void *pData, size_t nSize) {
+  if (pData == nullptr || nSize < sizeof(SprFileHeader))
+    return olc::FAIL;
+
+  const SprFileHeader *h = (const SprFileHeader*) pData;
+  bool bValid = memcmp(h->sMagic, sSprMagic, sizeof(sSprMagic)) == 0 && h->nVersion == 1 && h->nFlags == 0
+      && h->nWidth > 0 && h->nWidth <= nSprMaxSide && h->nHeight > 0 && h->nHeight <= nSprMaxSide
+      && h->nDataOffset >= sizeof(SprFileHeader) && h->nDataOffset % 16 == 0
+      && h->nDataOffset + (size_t) h->nWidth * h->nHeight * sizeof(Pixel) <= nSize;
+  if (!bValid)
+    return olc::FAIL;
+
+  olc_Release();
+  width = h->nWidth;
+  height = h->nHeight;
+  cellWidth = h->nCellWidth;
+  cellHeight = h->nCellHeight;
+  pColData = (Pixel*) ((uint8_t*) pData + h->nDataOffset);
+  bBorrowed = true;
+  return olc::OK;
+}
+
+olc::rcode Sprite::SaveToSprFile(std::string sImageFile) {
+  std::ofstream file(sImageFile, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+    return olc::NO_FILE;
+  if (SaveToSprFile(file) != olc::OK)
+    return olc::FAIL;
+  file.close();
+  return file ? olc::OK : olc::FAIL;
+}
+
+olc::rcode Sprite::SaveToSprFile(std::ostream &os) {
+  if (pColData == nullptr || width <= 0 || height <= 0)
+    return olc::FAIL;
+
+  SprFileHeader h;
+  memcpy(h.sMagic, sSprMagic, sizeof(sSprMagic));
+  h.nVersion = 1;
+  h.nWidth = width;
+  h.nHeight = height;
+  h.nCellWidth = cellWidth;
+  h.nCellHeight = cellHeight;
+  h.nFlags = 0;
+  h.nDataOffset = (sizeof(SprFileHeader) + 15) & ~15u;
+
+  os.write((const char*) &h, sizeof(h));
+  for (size_t i = sizeof(h); i < h.nDataOffset; i++)
+    os.put(0);
+  os.write((const char*) pColData, (std::streamsize) width * height * sizeof(Pixel));
+  return os ? olc::OK : olc::FAIL;
 }
 
 olc::rcode Sprite::LoadFromFile(std::string sImageFile) {
+  olc_Release();
 #ifdef _WIN32
   // Use GDI+
   std::wstring wsImageFile;
@@ -314,9 +444,319 @@ Pixel* Sprite::GetData() {
 
 //==========================================================
 
+#ifdef __linux__
+static int olc_PerfEventOpen(perf_event_attr *attr, int nGroup) {
+  // This thread, any CPU
+  return (int) syscall(__NR_perf_event_open, attr, 0, -1, nGroup, 0);
+}
+#endif
+
+PerfCounterGroup::~PerfCounterGroup() {
+  Close();
+}
+
+bool PerfCounterGroup::Open() {
+  Close();
+#ifdef __linux__
+  static const struct {
+    uint32_t nType;
+    uint64_t nConfig;
+  } events[PERF_COUNTERS] = {
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+      { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+      { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES } };
+
+  int nErrno = 0;
+  for (int c = 0; c < PERF_COUNTERS; c++) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[c].nType;
+    attr.config = events[c].nConfig;
+    // The leader holds the whole group off until it is complete
+    attr.disabled = nLeader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    int fd = olc_PerfEventOpen(&attr, nLeader);
+    if (fd < 0) {
+      if (nErrno == 0)
+        nErrno = errno;
+      continue;
+    }
+    if (nLeader < 0)
+      nLeader = fd;
+    nFd[c] = fd;
+    nSlot[c] = nOpen++;
+  }
+
+  if (nLeader < 0) {
+    sError = std::string("perf_event_open: ") + strerror(nErrno);
+    if (nErrno == EACCES || nErrno == EPERM) {
+      std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+      int nParanoid = 0;
+      if (file >> nParanoid)
+        sError += ", kernel.perf_event_paranoid is " + std::to_string(nParanoid);
+    }
+    return false;
+  }
+
+  ioctl(nLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(nLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  sError.clear();
+  return true;
+#else
+  sError = "hardware counters need Linux perf_event_open()";
+  return false;
+#endif
+}
+
+void PerfCounterGroup::Close() {
+#ifdef __linux__
+  for (int c = 0; c < PERF_COUNTERS; c++)
+    if (nFd[c] >= 0)
+      close(nFd[c]);
+#endif
+  for (int c = 0; c < PERF_COUNTERS; c++) {
+    nFd[c] = -1;
+    nSlot[c] = -1;
+  }
+  nLeader = -1;
+  nOpen = 0;
+}
+
+bool PerfCounterGroup::IsOpen() const {
+  return nLeader >= 0;
+}
+
+bool PerfCounterGroup::IsAvailable(PerfCounter c) const {
+  return nFd[c] >= 0;
+}
+
+bool PerfCounterGroup::Read(uint64_t nCount[PERF_COUNTERS]) {
+#ifdef __linux__
+  // nr, time enabled, time running, then one value per open counter
+  uint64_t nData[3 + PERF_COUNTERS];
+  if (nLeader < 0 || read(nLeader, nData, sizeof(nData)) < (ssize_t) ((3 + nOpen) * sizeof(uint64_t)))
+    return false;
+
+  uint64_t nEnabled = nData[1], nRunning = nData[2];
+  for (int c = 0; c < PERF_COUNTERS; c++) {
+    nCount[c] = 0;
+    if (nSlot[c] < 0)
+      continue;
+    nCount[c] = nData[3 + nSlot[c]];
+    if (nRunning > 0 && nRunning < nEnabled)
+      nCount[c] = (uint64_t) ((double) nCount[c] * nEnabled / nRunning);
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+const std::string& PerfCounterGroup::GetError() const {
+  return sError;
+}
+
+const char* PerfCounterGroup::GetCounterName(PerfCounter c) {
+  static const char *sNames[PERF_COUNTERS] = { "cycles", "instructions", "l1d_misses", "llc_misses",
+      "branch_misses" };
+  return sNames[c];
+}
+
+//==========================================================
+
+const uint32_t FrameProfiler::nWindow;
+
+void FrameProfiler::Begin(ProfilePhase p) {
+  // Counters first so reading them isn't in the phase's time
+  if (counters.IsOpen())
+    counters.Read(nCountBegin[p]);
+  tpBegin[p] = std::chrono::steady_clock::now();
+}
+
+void FrameProfiler::End(ProfilePhase p) {
+  std::chrono::duration<float, std::micro> d = std::chrono::steady_clock::now() - tpBegin[p];
+  fFrame[p] += d.count();
+
+  uint64_t nCount[PERF_COUNTERS];
+  if (counters.IsOpen() && counters.Read(nCount)) {
+    // Multiplex scaling can make a total step back a little
+    for (int c = 0; c < PERF_COUNTERS; c++)
+      if (nCount[c] > nCountBegin[p][c])
+        nCountFrame[p][c] += nCount[c] - nCountBegin[p][c];
+  }
+}
+
+void FrameProfiler::EndFrame() {
+  if (fileCsv.is_open()) {
+    if (nFrames == 0) {
+      fileCsv << "frame";
+      for (int p = 0; p < PROFILE_PHASES; p++)
+        fileCsv << "," << GetPhaseName((ProfilePhase) p) << "_us";
+      for (int p = 0; p < PROFILE_PHASES; p++)
+        for (int c = 0; c < PERF_COUNTERS; c++)
+          if (counters.IsAvailable((PerfCounter) c))
+            fileCsv << "," << GetPhaseName((ProfilePhase) p) << "_"
+                << PerfCounterGroup::GetCounterName((PerfCounter) c);
+      fileCsv << "\n";
+    }
+    fileCsv << nFrames;
+    for (int p = 0; p < PROFILE_PHASES; p++)
+      fileCsv << "," << fFrame[p];
+    for (int p = 0; p < PROFILE_PHASES; p++)
+      for (int c = 0; c < PERF_COUNTERS; c++)
+        if (counters.IsAvailable((PerfCounter) c))
+          fileCsv << "," << nCountFrame[p][c];
+    fileCsv << "\n";
+  }
+
+  for (int p = 0; p < PROFILE_PHASES; p++) {
+    fWindow[p][nFrames % nWindow] = fFrame[p];
+    fFrame[p] = 0.0f;
+    for (int c = 0; c < PERF_COUNTERS; c++) {
+      nCountWindow[p][c][nFrames % nWindow] = nCountFrame[p][c];
+      nCountFrame[p][c] = 0;
+    }
+  }
+  nFrames++;
+}
+
+FrameProfiler::Stats FrameProfiler::GetStats(ProfilePhase p) const {
+  Stats stats = { 0.0f, 0.0f, 0.0f };
+  uint32_t n = std::min(nFrames, nWindow);
+  if (n == 0)
+    return stats;
+
+  std::vector<float> v(fWindow[p], fWindow[p] + n);
+  stats.fMin = *std::min_element(v.begin(), v.end());
+  for (float f : v)
+    stats.fAvg += f;
+  stats.fAvg /= n;
+  std::nth_element(v.begin(), v.begin() + (n * 99) / 100, v.end());
+  stats.fP99 = v[(n * 99) / 100];
+  return stats;
+}
+
+uint32_t FrameProfiler::GetFrameCount() const {
+  return nFrames;
+}
+
+bool FrameProfiler::OpenCsv(const std::string &sFile) {
+  fileCsv.open(sFile, std::ios::out | std::ios::trunc);
+  return fileCsv.is_open();
+}
+
+bool FrameProfiler::OpenCounters() {
+  return counters.Open();
+}
+
+const PerfCounterGroup& FrameProfiler::GetCounters() const {
+  return counters;
+}
+
+double FrameProfiler::GetCounterAvg(ProfilePhase p, PerfCounter c) const {
+  uint32_t n = std::min(nFrames, nWindow);
+  if (n == 0)
+    return 0.0;
+  double fSum = 0.0;
+  for (uint32_t i = 0; i < n; i++)
+    fSum += (double) nCountWindow[p][c][i];
+  return fSum / n;
+}
+
+const char* FrameProfiler::GetPhaseName(ProfilePhase p) {
+  static const char *sNames[PROFILE_PHASES] = { "events", "input", "update", "user_update", "user_draw", "upload",
+      "swap", "frame", "wait" };
+  return sNames[p];
+}
+
+//==========================================================
+
+void DirtyRegion::Resize(int32_t w, int32_t h) {
+  nWidth = w;
+  nHeight = h;
+  vRowMin.assign(h, w);
+  vRowMax.assign(h, -1);
+  nMinY = h;
+  nMaxY = -1;
+}
+
+void DirtyRegion::Add(int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+  x1 = std::max(x1, 0);
+  y1 = std::max(y1, 0);
+  x2 = std::min(x2, nWidth - 1);
+  y2 = std::min(y2, nHeight - 1);
+  if (x1 > x2 || y1 > y2)
+    return;
+
+  nMinY = std::min(nMinY, y1);
+  nMaxY = std::max(nMaxY, y2);
+  for (int32_t y = y1; y <= y2; y++) {
+    vRowMin[y] = std::min(vRowMin[y], x1);
+    vRowMax[y] = std::max(vRowMax[y], x2);
+  }
+}
+
+void DirtyRegion::AddAll() {
+  Add(0, 0, nWidth - 1, nHeight - 1);
+}
+
+void DirtyRegion::Reset() {
+  // Only the rows touched since the last reset need clearing
+  for (int32_t y = nMinY; y <= nMaxY; y++) {
+    vRowMin[y] = nWidth;
+    vRowMax[y] = -1;
+  }
+  nMinY = nHeight;
+  nMaxY = -1;
+}
+
+bool DirtyRegion::IsEmpty() const {
+  return nMaxY < nMinY;
+}
+
+void DirtyRegion::GetBands(std::vector<Band> &vBands) const {
+  vBands.clear();
+  for (int32_t y = nMinY; y <= nMaxY; y++) {
+    if (vRowMax[y] < 0)
+      continue;
+
+    // Grow the current band if this row touches it, else start a new one
+    if (!vBands.empty()) {
+      Band &b = vBands.back();
+      if (b.y + b.h == y && vRowMin[y] <= b.x + b.w && vRowMax[y] >= b.x - 1) {
+        int32_t x2 = std::max(b.x + b.w - 1, vRowMax[y]);
+        b.x = std::min(b.x, vRowMin[y]);
+        b.w = x2 - b.x + 1;
+        b.h++;
+        continue;
+      }
+    }
+    vBands.push_back( { vRowMin[y], y, vRowMax[y] - vRowMin[y] + 1, 1 });
+  }
+}
+
+uint32_t DirtyRegion::GetPixelCount() const {
+  std::vector<Band> vBands;
+  GetBands(vBands);
+  uint32_t n = 0;
+  for (auto &b : vBands)
+    n += b.w * b.h;
+  return n;
+}
+
+//==========================================================
+
 PixelGameEngine::PixelGameEngine() {
   sAppName = "Undefined";
   olc::PGEX::pge = this;
+  pBlendSpan = GetBlendSpanKernel();
 }
 
 olc::rcode PixelGameEngine::Construct(uint32_t screen_w, uint32_t screen_h, uint32_t pixel_w, uint32_t pixel_h,
@@ -325,31 +765,37 @@ olc::rcode PixelGameEngine::Construct(uint32_t screen_w, uint32_t screen_h, uint
   nScreenHeight = screen_h;
   nPixelWidth = pixel_w;
   nPixelHeight = pixel_h;
-  fFramePeriod = 1.0f / (float) framerate;
+  SetFrameRate(framerate);
 
   if (nPixelWidth == 0 || nPixelHeight == 0 || nScreenWidth == 0 || nScreenHeight == 0)
     return olc::FAIL;
 
-#ifdef _WIN32
-#ifdef UNICODE
-#ifndef __MINGW32__
-  std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-  wsAppName = converter.from_bytes(sAppName);
-#endif
-#endif
-#endif
   // Load the default font sheet
   olc_ConstructFontSheet();
 
   // Create a sprite that represents the primary drawing target
   pDefaultDrawTarget = new Sprite(nScreenWidth, nScreenHeight);
   SetDrawTarget(nullptr);
+
+  // The first frame presents the whole screen
+  dirtyScreen.Resize(nScreenWidth, nScreenHeight);
+  dirtyScreen.AddAll();
   return olc::OK;
 }
 
 olc::rcode PixelGameEngine::Start() {
+  // Present to the native window unless a platform has been provided
+  if (pPlatform == nullptr) {
+#ifdef OLC_HEADLESS
+    pPlatform = new Platform_Null();
+#else
+    pPlatform = new Platform_Native();
+#endif
+    bOwnsPlatform = true;
+  }
+
   // Construct the window
-  if (!olc_WindowCreate())
+  if (pPlatform->CreateWindowPane(this, nScreenWidth, nScreenHeight, nPixelWidth, nPixelHeight) != olc::OK)
     return olc::FAIL;
 
   // Load libraries required for PNG file interaction
@@ -366,21 +812,161 @@ olc::rcode PixelGameEngine::Start() {
   bAtomActive = true;
   std::thread t = std::thread(&PixelGameEngine::EngineThread, this);
 
-#ifdef _WIN32
-  // Handle Windows Message Loop
-  MSG msg;
-  while (GetMessage(&msg, NULL, 0, 0) > 0)
-  {
-    TranslateMessage(&msg);
-    DispatchMessage(&msg);
-  }
-#endif
+  // Some platforms need to pump messages on the thread that made the window
+  pPlatform->StartSystemEventLoop();
 
   // Wait for thread to be exited
   t.join();
   return olc::OK;
 }
 
+void PixelGameEngine::SetPlatform(Platform *platform) {
+  if (bOwnsPlatform)
+    delete pPlatform;
+  pPlatform = platform;
+  bOwnsPlatform = false;
+}
+
+void PixelGameEngine::SetFrameRate(int32_t framerate) {
+  fFramePeriod = (framerate > 0) ? 1.0f / (float) framerate : 0.0f;
+}
+
+void PixelGameEngine::SetIdleMode(bool bIdle) {
+  bIdleMode = bIdle;
+}
+
+void PixelGameEngine::RequestFrame(float fDelay) {
+  auto tp = std::chrono::steady_clock::now()
+      + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(fDelay));
+  if (!bFrameRequested || tp < tpFrameRequested)
+    tpFrameRequested = tp;
+  bFrameRequested = true;
+}
+
+void PixelGameEngine::olc_WaitForFrame() {
+  auto tpNow = std::chrono::steady_clock::now();
+
+  // Idle: wait until input arrives or a requested frame is due. Platforms
+  // that collect events on this thread are polled while waiting
+  if (bIdleMode) {
+    const auto tpPoll = std::chrono::milliseconds(10);
+    while (bAtomActive && !bAtomInput && !(bFrameRequested && tpNow >= tpFrameRequested)) {
+      pPlatform->HandleSystemEvent();
+      auto tpWake = tpNow + tpPoll;
+      if (bFrameRequested && tpFrameRequested < tpWake)
+        tpWake = tpFrameRequested;
+      std::unique_lock<std::mutex> lock(muxIdle);
+      cvIdle.wait_until(lock, tpWake, [&] {return bAtomInput || !bAtomActive;});
+      tpNow = std::chrono::steady_clock::now();
+    }
+  }
+  bAtomInput = false;
+  bFrameRequested = false;
+
+  // Pace to the frame rate, a late frame restarts the schedule from now
+  // rather than running several frames back to back to catch up
+  if (fFramePeriod > 0.0f) {
+    if (tpNextFrame > tpNow)
+      std::this_thread::sleep_until(tpNextFrame);
+    else
+      tpNextFrame = tpNow;
+    tpNextFrame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<float>(fFramePeriod));
+  }
+}
+
+bool PixelGameEngine::EnableProfiler(bool bEnable, const std::string &sCsvFile, bool bCounters) {
+  delete pProfiler;
+  pProfiler = bEnable ? new FrameProfiler() : nullptr;
+  bProfilerCounters = bCounters;
+  // Counters follow the thread that opens them, once running that is
+  // the engine thread calling here, otherwise EngineThread() opens them
+  if (bAtomActive)
+    olc_OpenProfilerCounters();
+  if (pProfiler && !sCsvFile.empty())
+    return pProfiler->OpenCsv(sCsvFile);
+  return true;
+}
+
+FrameProfiler* PixelGameEngine::GetProfiler() {
+  return pProfiler;
+}
+
+void PixelGameEngine::olc_OpenProfilerCounters() {
+  if (pProfiler && bProfilerCounters && !pProfiler->OpenCounters())
+    std::cout << "Profiler: no hardware counters, " << pProfiler->GetCounters().GetError() << "\n";
+}
+
+void PixelGameEngine::ShowProfilerOverlay(bool bShow) {
+  bProfilerOverlay = bShow;
+}
+
+bool PixelGameEngine::IsProfilerOverlayShown() {
+  return bProfilerOverlay;
+}
+
+void PixelGameEngine::ProfileBegin(ProfilePhase p) {
+  if (pProfiler)
+    pProfiler->Begin(p);
+}
+
+void PixelGameEngine::ProfileEnd(ProfilePhase p) {
+  if (pProfiler)
+    pProfiler->End(p);
+}
+
+// The overlay box, one line per phase under a heading
+static const int32_t nOverlayW = 8 * 38 + 8;
+static const int32_t nOverlayH = 10 * (PROFILE_PHASES + 1) + 6;
+
+void PixelGameEngine::olc_DrawProfilerOverlay() {
+  int32_t w = std::min(nOverlayW, (int32_t) nScreenWidth);
+  int32_t h = std::min(nOverlayH, (int32_t) nScreenHeight);
+  Pixel *pScreen = pDefaultDrawTarget->GetData();
+  vOverlaySave.resize(w * h);
+  for (int32_t y = 0; y < h; y++)
+    memcpy(&vOverlaySave[y * w], pScreen + y * nScreenWidth, w * sizeof(Pixel));
+
+  Sprite *pTarget = pDrawTarget;
+  Pixel::Mode m = nPixelMode;
+  float fBlend = fBlendFactor;
+  SetDrawTarget(nullptr);
+  SetPixelMode(Pixel::ALPHA);
+  SetPixelBlend(1.0f);
+
+  FillRect(0, 0, w, h, Pixel(0, 0, 0, 200));
+  DrawString(4, 4, "phase          min     avg     p99 ms", WHITE);
+  for (int p = 0; p < PROFILE_PHASES; p++) {
+    FrameProfiler::Stats st = pProfiler->GetStats((ProfilePhase) p);
+    char sLine[64];
+    snprintf(sLine, 64, "%-12s %7.3f %7.3f %7.3f", FrameProfiler::GetPhaseName((ProfilePhase) p),
+        st.fMin / 1000.0f, st.fAvg / 1000.0f, st.fP99 / 1000.0f);
+    DrawString(4, 14 + p * 10, sLine, p == PROFILE_FRAME ? YELLOW : WHITE);
+  }
+
+  SetDrawTarget(pTarget);
+  SetPixelMode(m);
+  SetPixelBlend(fBlend);
+}
+
+void PixelGameEngine::olc_RestoreProfilerOverlay() {
+  // The restored pixels still differ from what was presented
+  int32_t w = std::min(nOverlayW, (int32_t) nScreenWidth);
+  int32_t h = std::min(nOverlayH, (int32_t) nScreenHeight);
+  Pixel *pScreen = pDefaultDrawTarget->GetData();
+  for (int32_t y = 0; y < h; y++)
+    memcpy(pScreen + y * nScreenWidth, &vOverlaySave[y * w], w * sizeof(Pixel));
+  dirtyScreen.Add(0, 0, w - 1, h - 1);
+}
+
+void PixelGameEngine::olc_WakeIdle() {
+  {
+    std::lock_guard<std::mutex> lock(muxIdle);
+    bAtomInput = true;
+  }
+  cvIdle.notify_one();
+}
+
 void PixelGameEngine::SetDrawTarget(Sprite *target) {
   if (target)
     pDrawTarget = target;
@@ -434,10 +1020,230 @@ int32_t PixelGameEngine::ScreenHeight() {
   return nScreenHeight;
 }
 
+//==========================================================
+// Alpha blend kernels. Every kernel computes exactly the same result as
+// the scalar reference: a = src.a * nBlend / 255, out = (src * a + dst *
+// (255 - a)) / 255 per channel, rounded, and the result is opaque
+
+// x / 255 rounded to nearest, exact for 0 <= x <= 65025
+static inline uint32_t olc_Div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+template<bool bScale>
+static inline Pixel olc_BlendAlpha(Pixel d, Pixel p, uint8_t nBlend) {
+  uint32_t a = p.a;
+  if (bScale)
+    a = olc_Div255(a * nBlend);
+  uint32_t c = 255 - a;
+  return Pixel(olc_Div255(p.r * a + d.r * c), olc_Div255(p.g * a + d.g * c), olc_Div255(p.b * a + d.b * c));
+}
+
+template<bool bScale>
+static void olc_BlendSpan_ScalarT(Pixel *dst, const Pixel *src, int32_t n, uint8_t nBlend) {
+  for (int32_t i = 0; i < n; i++)
+    dst[i] = olc_BlendAlpha<bScale>(dst[i], src[i], nBlend);
+}
+
+// Each kernel is instantiated with and without blend factor scaling, the
+// choice between them is made once per span
+#define OLC_BLEND_DISPATCH(name, attr) \
+  static attr void name(Pixel *dst, const Pixel *src, int32_t n, uint8_t nBlend) { \
+    if (nBlend == 255) \
+      name##T<false>(dst, src, n, nBlend); \
+    else \
+      name##T<true>(dst, src, n, nBlend); \
+  }
+
+OLC_BLEND_DISPATCH(olc_BlendSpan_Scalar, )
+
+#ifdef OLC_BLEND_SSE2
+// Two pixels per register as 16 bit channels, four pixels per loop
+static inline __m128i olc_Div255_SSE2(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+template<bool bScale>
+static inline __m128i olc_Blend2_SSE2(__m128i s, __m128i d, __m128i vBlend) {
+  // Copy each pixel's alpha into all four of its channels
+  __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+  if (bScale)
+    a = olc_Div255_SSE2(_mm_mullo_epi16(a, vBlend));
+  __m128i c = _mm_sub_epi16(_mm_set1_epi16(255), a);
+  return olc_Div255_SSE2(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, c)));
+}
+
+template<bool bScale>
+static void olc_BlendSpan_SSE2T(Pixel *dst, const Pixel *src, int32_t n, uint8_t nBlend) {
+  const __m128i vZero = _mm_setzero_si128();
+  const __m128i vOpaque = _mm_set1_epi32(0xFF000000);
+  const __m128i vBlend = _mm_set1_epi16(nBlend);
+
+  int32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+    __m128i lo = olc_Blend2_SSE2<bScale>(_mm_unpacklo_epi8(s, vZero), _mm_unpacklo_epi8(d, vZero), vBlend);
+    __m128i hi = olc_Blend2_SSE2<bScale>(_mm_unpackhi_epi8(s, vZero), _mm_unpackhi_epi8(d, vZero), vBlend);
+    _mm_storeu_si128((__m128i*) (dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), vOpaque));
+  }
+  olc_BlendSpan_ScalarT<bScale>(dst + i, src + i, n - i, nBlend);
+}
+
+OLC_BLEND_DISPATCH(olc_BlendSpan_SSE2, )
+#endif
+
+#ifdef OLC_BLEND_AVX2
+// As SSE2 but eight pixels per loop, only called when the CPU reports AVX2
+#define OLC_AVX2 __attribute__((target("avx2")))
+
+static inline OLC_AVX2 __m256i olc_Div255_AVX2(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+template<bool bScale>
+static inline OLC_AVX2 __m256i olc_Blend4_AVX2(__m256i s, __m256i d, __m256i vBlend) {
+  __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+  if (bScale)
+    a = olc_Div255_AVX2(_mm256_mullo_epi16(a, vBlend));
+  __m256i c = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+  return olc_Div255_AVX2(_mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, c)));
+}
+
+template<bool bScale>
+static OLC_AVX2 void olc_BlendSpan_AVX2T(Pixel *dst, const Pixel *src, int32_t n, uint8_t nBlend) {
+  const __m256i vZero = _mm256_setzero_si256();
+  const __m256i vOpaque = _mm256_set1_epi32(0xFF000000);
+  const __m256i vBlend = _mm256_set1_epi16(nBlend);
+
+  // Unpack and pack both work within 128 bit lanes, so pixel order is kept
+  int32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+    __m256i d = _mm256_loadu_si256((const __m256i*) (dst + i));
+    __m256i lo = olc_Blend4_AVX2<bScale>(_mm256_unpacklo_epi8(s, vZero), _mm256_unpacklo_epi8(d, vZero), vBlend);
+    __m256i hi = olc_Blend4_AVX2<bScale>(_mm256_unpackhi_epi8(s, vZero), _mm256_unpackhi_epi8(d, vZero), vBlend);
+    _mm256_storeu_si256((__m256i*) (dst + i), _mm256_or_si256(_mm256_packus_epi16(lo, hi), vOpaque));
+  }
+  // Unoptimised builds don't clear the upper halves themselves, and every SSE instruction after
+  // this (the tail, libm, the caller) would pay for the AVX to SSE transition
+  _mm256_zeroupper();
+  olc_BlendSpan_SSE2T<bScale>(dst + i, src + i, n - i, nBlend);
+}
+
+OLC_BLEND_DISPATCH(olc_BlendSpan_AVX2, OLC_AVX2)
+#endif
+
+BlendSpanFunc GetBlendSpanKernel(BlendKernel k) {
+  switch (k) {
+  case BLEND_SCALAR:
+    return olc_BlendSpan_Scalar;
+#ifdef OLC_BLEND_SSE2
+  case BLEND_SSE2:
+    return olc_BlendSpan_SSE2;
+#endif
+#ifdef OLC_BLEND_AVX2
+  case BLEND_AVX2:
+    return __builtin_cpu_supports("avx2") ? olc_BlendSpan_AVX2 : nullptr;
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+BlendSpanFunc GetBlendSpanKernel() {
+  static BlendSpanFunc pBest = nullptr;
+  for (int k = BLEND_AVX2; pBest == nullptr && k >= BLEND_SCALAR; k--)
+    pBest = GetBlendSpanKernel((BlendKernel) k);
+  return pBest;
+}
+
+//==========================================================
+// Span functions specialized per pixel mode. Primitives pick the function
+// for the current mode once per call and then only pass it whole spans
+
+// Copies a row of n sprite pixels onto dst
+template<Pixel::Mode M>
+static void olc_CopySpanT(Pixel *dst, const Pixel *src, int32_t n, uint8_t nBlend) {
+  if (M == Pixel::NORMAL) {
+    // The sprite may be the draw target itself, so spans can overlap
+    memmove(dst, src, n * sizeof(Pixel));
+  } else {
+    for (int32_t i = 0; i < n; i++)
+      if (src[i].a == 255)
+        dst[i] = src[i];
+  }
+}
+
+// Fills a row of n pixels with a single colour
+template<Pixel::Mode M>
+static void olc_FillSpanT(Pixel *dst, int32_t n, Pixel p, uint8_t nBlend) {
+  if (M == Pixel::NORMAL || (M == Pixel::MASK && p.a == 255)) {
+    std::fill(dst, dst + n, p);
+  } else if (M == Pixel::ALPHA) {
+    // The source side of the blend is the same for every pixel
+    uint32_t a = olc_Div255(p.a * nBlend);
+    uint32_t c = 255 - a;
+    uint32_t r = p.r * a, g = p.g * a, b = p.b * a;
+    for (int32_t i = 0; i < n; i++)
+      dst[i] = Pixel(olc_Div255(r + dst[i].r * c), olc_Div255(g + dst[i].g * c), olc_Div255(b + dst[i].b * c));
+  }
+}
+
+PixelGameEngine::SpanFunc PixelGameEngine::olc_GetCopySpan() {
+  switch (nPixelMode) {
+  case Pixel::MASK:
+    return olc_CopySpanT<Pixel::MASK>;
+  case Pixel::ALPHA:
+    return pBlendSpan;
+  default:
+    return olc_CopySpanT<Pixel::NORMAL>;
+  }
+}
+
+PixelGameEngine::FillFunc PixelGameEngine::olc_GetFillSpan(Pixel::Mode m) {
+  switch (m) {
+  case Pixel::MASK:
+    return olc_FillSpanT<Pixel::MASK>;
+  case Pixel::ALPHA:
+    return olc_FillSpanT<Pixel::ALPHA>;
+  default:
+    return olc_FillSpanT<Pixel::NORMAL>;
+  }
+}
+
+// Fills x1..x2 inclusive on row y, clipped to the draw target
+void PixelGameEngine::olc_FillRow(FillFunc fill, int32_t x1, int32_t x2, int32_t y, Pixel p) {
+  if (y < 0 || y >= pDrawTarget->height)
+    return;
+  x1 = std::max(x1, 0);
+  x2 = std::min(x2, pDrawTarget->width - 1);
+  if (x1 <= x2) {
+    fill(pDrawTarget->GetData() + y * pDrawTarget->width + x1, x2 - x1 + 1, p, nBlendFactor);
+    olc_MarkDirty(x1, y, x2, y);
+  }
+}
+
+void PixelGameEngine::olc_MarkDirty(int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+  if (pDrawTarget == pDefaultDrawTarget)
+    dirtyScreen.Add(x1, y1, x2, y2);
+}
+
+void PixelGameEngine::MarkDirty(int32_t x, int32_t y, int32_t w, int32_t h) {
+  dirtyScreen.Add(x, y, x + w - 1, y + h - 1);
+}
+
+//==========================================================
+
 void PixelGameEngine::Draw(int32_t x, int32_t y, Pixel p) {
   if (!pDrawTarget)
     return;
 
+  olc_MarkDirty(x, y, x, y);
+
   if (nPixelMode == Pixel::NORMAL) {
     pDrawTarget->SetPixel(x, y, p);
     return;
@@ -450,18 +1256,17 @@ void PixelGameEngine::Draw(int32_t x, int32_t y, Pixel p) {
   }
 
   if (nPixelMode == Pixel::ALPHA) {
-    Pixel d = pDrawTarget->GetPixel(x, y);
-    float a = (float) (p.a / 255.0f) * fBlendFactor;
-    float c = 1.0f - a;
-    float r = a * (float) p.r + c * (float) d.r;
-    float g = a * (float) p.g + c * (float) d.g;
-    float b = a * (float) p.b + c * (float) d.b;
-    pDrawTarget->SetPixel(x, y, Pixel((uint8_t) r, (uint8_t) g, (uint8_t) b));
+    pDrawTarget->SetPixel(x, y, olc_BlendAlpha<true>(pDrawTarget->GetPixel(x, y), p, nBlendFactor));
     return;
   }
 }
 
 void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p) {
+  if (!pDrawTarget)
+    return;
+  FillFunc fill = olc_GetFillSpan(nPixelMode);
+  auto Plot = [&](int x, int y) {olc_FillRow(fill, x, x, y, p);};
+
   int x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
   dx = x2 - x1;
   dy = y2 - y1;
@@ -480,7 +1285,7 @@ void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, P
       xe = x1;
     }
 
-    Draw(x, y, p);
+    Plot(x, y);
 
     for (i = 0; x < xe; i++) {
       x = x + 1;
@@ -493,7 +1298,7 @@ void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, P
           y = y - 1;
         px = px + 2 * (dy1 - dx1);
       }
-      Draw(x, y, p);
+      Plot(x, y);
     }
   } else {
     if (dy >= 0) {
@@ -506,7 +1311,7 @@ void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, P
       ye = y1;
     }
 
-    Draw(x, y, p);
+    Plot(x, y);
 
     for (i = 0; y < ye; i++) {
       y = y + 1;
@@ -519,7 +1324,7 @@ void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, P
           x = x - 1;
         py = py + 2 * (dx1 - dy1);
       }
-      Draw(x, y, p);
+      Plot(x, y);
     }
   }
 }
@@ -528,19 +1333,22 @@ void PixelGameEngine::DrawCircle(int32_t x, int32_t y, int32_t radius, Pixel p)
   int x0 = 0;
   int y0 = radius;
   int d = 3 - 2 * radius;
-  if (!radius)
+  if (!radius || !pDrawTarget)
     return;
 
+  FillFunc fill = olc_GetFillSpan(nPixelMode);
+  auto Plot = [&](int px, int py) {olc_FillRow(fill, px, px, py, p);};
+
   while (y0 >= x0) // only formulate 1/8 of circle
   {
-    Draw(x - x0, y - y0, p); //upper left left
-    Draw(x - y0, y - x0, p); //upper upper left
-    Draw(x + y0, y - x0, p); //upper upper right
-    Draw(x + x0, y - y0, p); //upper right right
-    Draw(x - x0, y + y0, p); //lower left left
-    Draw(x - y0, y + x0, p); //lower lower left
-    Draw(x + y0, y + x0, p); //lower lower right
-    Draw(x + x0, y + y0, p); //lower right right
+    Plot(x - x0, y - y0); //upper left left
+    Plot(x - y0, y - x0); //upper upper left
+    Plot(x + y0, y - x0); //upper upper right
+    Plot(x + x0, y - y0); //upper right right
+    Plot(x - x0, y + y0); //lower left left
+    Plot(x - y0, y + x0); //lower lower left
+    Plot(x + y0, y + x0); //lower lower right
+    Plot(x + x0, y + y0); //lower right right
     if (d < 0)
       d += 4 * x0++ + 6;
     else
@@ -553,14 +1361,11 @@ void PixelGameEngine::FillCircle(int32_t x, int32_t y, int32_t radius, Pixel p)
   int x0 = 0;
   int y0 = radius;
   int d = 3 - 2 * radius;
-  if (!radius)
+  if (!radius || !pDrawTarget)
     return;
 
-  auto drawline = [&](int sx, int ex, int ny)
-  {
-    for (int i = sx; i <= ex; i++)
-    Draw(i, ny, p);
-  };
+  FillFunc fill = olc_GetFillSpan(nPixelMode);
+  auto drawline = [&](int sx, int ex, int ny) {olc_FillRow(fill, sx, ex, ny, p);};
 
   while (y0 >= x0) {
     // Modified to draw scan-lines instead of edges
@@ -587,33 +1392,18 @@ void PixelGameEngine::Clear(Pixel p) {
   Pixel* m = GetDrawTarget()->GetData();
   for (int i = 0; i < pixels; i++)
     m[i] = p;
+  olc_MarkDirty(0, 0, GetDrawTargetWidth() - 1, GetDrawTargetHeight() - 1);
 }
 
 void PixelGameEngine::FillRect(int32_t x, int32_t y, int32_t w, int32_t h, Pixel p) {
-  int32_t x2 = x + w;
-  int32_t y2 = y + h;
-
-  if (x < 0)
-    x = 0;
-  if (x >= (int32_t) nScreenWidth)
-    x = (int32_t) nScreenWidth;
-  if (y < 0)
-    y = 0;
-  if (y >= (int32_t) nScreenHeight)
-    y = (int32_t) nScreenHeight;
-
-  if (x2 < 0)
-    x2 = 0;
-  if (x2 >= (int32_t) nScreenWidth)
-    x2 = (int32_t) nScreenWidth;
-  if (y2 < 0)
-    y2 = 0;
-  if (y2 >= (int32_t) nScreenHeight)
-    y2 = (int32_t) nScreenHeight;
+  if (!pDrawTarget)
+    return;
 
-  for (int i = x; i < x2; i++)
-    for (int j = y; j < y2; j++)
-      Draw(i, j, p);
+  // Rows are clipped by olc_FillRow, only the row range is clipped here
+  int32_t y2 = std::min(y + h, pDrawTarget->height);
+  FillFunc fill = olc_GetFillSpan(nPixelMode);
+  for (int32_t j = std::max(y, 0); j < y2; j++)
+    olc_FillRow(fill, x, x + w - 1, j, p);
 }
 
 void PixelGameEngine::DrawTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p) {
@@ -624,8 +1414,12 @@ void PixelGameEngine::DrawTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y
 
 // https://www.avrfreaks.net/sites/default/files/triangles.c
 void PixelGameEngine::FillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p) {
+  if (!pDrawTarget)
+    return;
+
+  FillFunc fill = olc_GetFillSpan(nPixelMode);
   auto SWAP = [](int &x, int &y) {int t = x; x = y; y = t;};
-  auto drawline = [&](int sx, int ex, int ny) {for (int i = sx; i <= ex; i++) Draw(i, ny, p);};
+  auto drawline = [&](int sx, int ex, int ny) {olc_FillRow(fill, sx, ex, ny, p);};
 
   int t1x, t2x, y, minx, maxx, t1xp, t2xp;
   bool changed1 = false;
@@ -834,70 +1628,178 @@ void PixelGameEngine::DrawSprite(int32_t x, int32_t y, Sprite *sprite) {
   if (sprite == nullptr)
     return;
 
-  for (int i = 0; i < sprite->width; i++) {
-    for (int j = 0; j < sprite->height; j++) {
-      Draw(x + i, y + j, sprite->GetPixel(i, j));
-    }
-  }
+  DrawPartialSprite(x, y, sprite, 0, 0, sprite->width, sprite->height);
 }
 
 void PixelGameEngine::DrawPartialSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy, int32_t w,
     int32_t h) {
-  if (sprite == nullptr)
+  if (sprite == nullptr || pDrawTarget == nullptr)
+    return;
+
+  // Clip the selected area to the sprite...
+  if (ox < 0) {
+    x -= ox;
+    w += ox;
+    ox = 0;
+  }
+  if (oy < 0) {
+    y -= oy;
+    h += oy;
+    oy = 0;
+  }
+  w = std::min(w, sprite->width - ox);
+  h = std::min(h, sprite->height - oy);
+
+  // ...and then to the draw target, once, so rows can be processed whole
+  if (x < 0) {
+    ox -= x;
+    w += x;
+    x = 0;
+  }
+  if (y < 0) {
+    oy -= y;
+    h += y;
+    y = 0;
+  }
+  w = std::min(w, pDrawTarget->width - x);
+  h = std::min(h, pDrawTarget->height - y);
+  if (w <= 0 || h <= 0)
+    return;
+
+  olc_MarkDirty(x, y, x + w - 1, y + h - 1);
+  SpanFunc copy = olc_GetCopySpan();
+  const Pixel *src = sprite->GetData() + oy * sprite->width + ox;
+  Pixel *dst = pDrawTarget->GetData() + y * pDrawTarget->width + x;
+  for (int32_t j = 0; j < h; j++) {
+    copy(dst, src, w, nBlendFactor);
+    src += sprite->width;
+    dst += pDrawTarget->width;
+  }
+}
+
+void PixelGameEngine::DrawRotatedPartialSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy,
+    int32_t w, int32_t h, float fAngle) {
+  if (sprite == nullptr || pDrawTarget == nullptr || w <= 0 || h <= 0)
+    return;
+
+  // Trig once per call, everything per pixel is 16.16 fixed point
+  float fRad = fAngle * 0.01745329252f;
+  float fCos = cosf(fRad);
+  float fSin = sinf(fRad);
+
+  // Destination bounding box of the rotated area, clipped to the target
+  float fExtX = 0.5f * (fabsf(w * fCos) + fabsf(h * fSin));
+  float fExtY = 0.5f * (fabsf(w * fSin) + fabsf(h * fCos));
+  int32_t sx = std::max((int32_t) floorf(x - fExtX), 0);
+  int32_t ex = std::min((int32_t) ceilf(x + fExtX), pDrawTarget->width);
+  int32_t sy = std::max((int32_t) floorf(y - fExtY), 0);
+  int32_t ey = std::min((int32_t) ceilf(y + fExtY), pDrawTarget->height);
+  if (sx >= ex || sy >= ey)
     return;
 
-  for (int i = 0; i < w; i++) {
-    for (int j = 0; j < h; j++) {
-      Draw(x + i, y + j, sprite->GetPixel(i + ox, j + oy));
+  // Inverse map: each destination pixel centre looks up the source pixel
+  // it came from, so the result has no holes
+  const float fOne = 65536.0f;
+  int32_t nCos = (int32_t) (fCos * fOne);
+  int32_t nSin = (int32_t) (fSin * fOne);
+  float fu = sx + 0.5f - x;
+  float fv = sy + 0.5f - y;
+  int32_t nRowU = (int32_t) ((fu * fCos + fv * fSin + 0.5f * w) * fOne);
+  int32_t nRowV = (int32_t) ((fv * fCos - fu * fSin + 0.5f * h) * fOne);
+  uint32_t nMaxU = (uint32_t) w << 16;
+  uint32_t nMaxV = (uint32_t) h << 16;
+
+  // Each destination row crosses the source area in (nearly always) one
+  // run; the source pixels of a run are gathered and written as a span
+  if ((int32_t) vSpanBuffer.size() < ex - sx)
+    vSpanBuffer.resize(ex - sx);
+  SpanFunc copy = olc_GetCopySpan();
+  const Pixel *pSrc = sprite->GetData();
+  Pixel *pDst = pDrawTarget->GetData() + sy * pDrawTarget->width;
+
+  for (int32_t j = sy; j < ey; j++, pDst += pDrawTarget->width) {
+    int32_t u = nRowU;
+    int32_t v = nRowV;
+    int32_t i = sx;
+    while (i < ex) {
+      // Unsigned compare rejects negative coordinates too
+      while (i < ex && !((uint32_t) u < nMaxU && (uint32_t) v < nMaxV)) {
+        u += nCos;
+        v -= nSin;
+        i++;
+      }
+      int32_t nStart = i;
+      while (i < ex && (uint32_t) u < nMaxU && (uint32_t) v < nMaxV) {
+        int32_t px = ox + (u >> 16), py = oy + (v >> 16);
+        vSpanBuffer[i - nStart] = (px >= 0 && px < sprite->width && py >= 0 && py < sprite->height) ?
+            pSrc[py * sprite->width + px] : Pixel(0, 0, 0, 0);
+        u += nCos;
+        v -= nSin;
+        i++;
+      }
+      if (i > nStart) {
+        copy(pDst + nStart, vSpanBuffer.data(), i - nStart, nBlendFactor);
+        olc_MarkDirty(nStart, j, i - 1, j);
+      }
     }
+    nRowU += nSin;
+    nRowV += nCos;
   }
 }
 
 void PixelGameEngine::DrawString(int32_t x, int32_t y, std::string sText, Pixel col, uint32_t scale) {
+  if (!pDrawTarget)
+    return;
+
   int32_t sx = 0;
   int32_t sy = 0;
-  Pixel::Mode m = nPixelMode;
-  if (col.ALPHA != 255)
-    SetPixelMode(Pixel::ALPHA);
-  else
-    SetPixelMode(Pixel::MASK);
-  for (auto c : sText) {
+  int32_t s = (int32_t) scale;
+  FillFunc fill = olc_GetFillSpan(col.a != 255 ? Pixel::ALPHA : Pixel::MASK);
+  const Pixel *pFont = fontSprite->GetData();
+  for (unsigned char c : sText) {
     if (c == '\n') {
       sx = 0;
-      sy += 8 * scale;
+      sy += 8 * s;
+    } else if (c < 32 || c > 127) {
+      // Not on the font sheet, e.g. a tab or a UTF-8 byte: a blank cell
+      sx += 8 * s;
     } else {
       int32_t ox = (c - 32) % 16;
       int32_t oy = (c - 32) / 16;
 
-      if (scale > 1) {
-        for (uint32_t i = 0; i < 8; i++)
-          for (uint32_t j = 0; j < 8; j++)
-            if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-              for (uint32_t is = 0; is < scale; is++)
-                for (uint32_t js = 0; js < scale; js++)
-                  Draw(x + sx + (i * scale) + is, y + sy + (j * scale) + js, col);
-      } else {
-        for (uint32_t i = 0; i < 8; i++)
-          for (uint32_t j = 0; j < 8; j++)
-            if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-              Draw(x + sx + i, y + sy + j, col);
+      // Each run of lit pixels in a glyph row is drawn as one span per scaled row
+      for (int32_t j = 0; j < 8; j++) {
+        const Pixel *pRow = pFont + (oy * 8 + j) * fontSprite->width + ox * 8;
+        for (int32_t i = 0; i < 8; i++) {
+          if (pRow[i].r == 0)
+            continue;
+          int32_t nStart = i;
+          while (i < 8 && pRow[i].r > 0)
+            i++;
+          for (int32_t js = 0; js < s; js++)
+            olc_FillRow(fill, x + sx + nStart * s, x + sx + i * s - 1, y + sy + j * s + js, col);
+        }
       }
-      sx += 8 * scale;
+      sx += 8 * s;
     }
   }
-  SetPixelMode(m);
 }
 
 void PixelGameEngine::SetPixelMode(Pixel::Mode m) {
   nPixelMode = m;
 }
 
+Pixel::Mode PixelGameEngine::GetPixelMode() {
+  return nPixelMode;
+}
+
 void PixelGameEngine::SetPixelBlend(float fBlend) {
   fBlendFactor = fBlend;
   if (fBlendFactor < 0.0f)
     fBlendFactor = 0.0f;
   if (fBlendFactor > 1.0f)
     fBlendFactor = 1.0f;
+  nBlendFactor = (uint8_t) (fBlendFactor * 255.0f + 0.5f);
 }
 
 // User must override these functions as required. I have not made
@@ -914,169 +1816,191 @@ bool PixelGameEngine::OnUserDestroy() {
 }
 //////////////////////////////////////////////////////////////////
 
-void PixelGameEngine::olc_UpdateMouse(uint32_t x, uint32_t y) {
+void PixelGameEngine::olc_UpdateMouse(int32_t x, int32_t y) {
   // Mouse coords come in screen space
   // But leave in pixel space
-  nMousePosX = x / nPixelWidth;
-  nMousePosY = y / nPixelHeight;
+  nInputMouseX = x / nPixelWidth;
+  nInputMouseY = y / nPixelHeight;
+  olc_PushInput(InputEvent::MOUSE_MOVE, 0, false);
 }
 
-void PixelGameEngine::EngineThread() {
-  // Start OpenGL, the context is owned by the game thread
-  olc_OpenGLCreate();
+void PixelGameEngine::olc_UpdateMouseState(int32_t button, bool state) {
+  if (button >= 0 && button < 5)
+    olc_PushInput(InputEvent::MOUSE_BUTTON, button, state);
+}
 
-  // Create Screen Texture - disable filtering
-  glEnable(GL_TEXTURE_2D);
-  glGenTextures(1, &glBuffer);
-  glBindTexture(GL_TEXTURE_2D, glBuffer);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+void PixelGameEngine::olc_UpdateKeyState(int32_t key, bool state) {
+  if (key >= 0 && key < 256)
+    olc_PushInput(InputEvent::KEY, key, state);
+}
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, nScreenWidth, nScreenHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-      pDefaultDrawTarget->GetData());
+void PixelGameEngine::olc_UpdateKeyFocus(bool state) {
+  olc_PushInput(InputEvent::FOCUS, 0, state);
+}
 
-  // Create user resources as part of this thread
-  if (!OnUserCreate())
+void PixelGameEngine::olc_PushInput(InputEvent::Type type, int32_t nCode, bool bDown) {
+  // Every event carries the mouse position, so a click knows where it was
+  InputEvent e;
+  e.type = type;
+  e.nCode = nCode;
+  e.bDown = bDown;
+  e.x = nInputMouseX;
+  e.y = nInputMouseY;
+  e.tp = std::chrono::steady_clock::now();
+  if (!queueInput.Push(e))
+    nAtomInputDropped.fetch_add(1, std::memory_order_relaxed);
+  olc_WakeIdle();
+}
+
+void PixelGameEngine::olc_UpdateInput() {
+  for (auto &b : pKeyboardState)
+    b.bPressed = b.bReleased = false;
+  for (auto &b : pMouseState)
+    b.bPressed = b.bReleased = false;
+  vFrameInput.clear();
+  nFrameInputPos = 0;
+
+  // A press and release in the same frame leave both flags set, repeated
+  // presses while held (key repeat) change nothing
+  InputEvent e;
+  while (queueInput.Pop(e)) {
+    vFrameInput.push_back(e);
+    HWButton *b;
+    switch (e.type) {
+    case InputEvent::KEY:
+      b = &pKeyboardState[e.nCode];
+      break;
+    case InputEvent::MOUSE_BUTTON:
+      b = &pMouseState[e.nCode];
+      break;
+    case InputEvent::MOUSE_MOVE:
+      nMousePosX = e.x;
+      nMousePosY = e.y;
+      continue;
+    case InputEvent::FOCUS:
+      bHasInputFocus = e.bDown;
+      continue;
+    default:
+      continue;
+    }
+
+    if (e.bDown && !b->bHeld) {
+      b->bPressed = true;
+      b->bHeld = true;
+    } else if (!e.bDown && b->bHeld) {
+      b->bReleased = true;
+      b->bHeld = false;
+    }
+  }
+}
+
+uint32_t PixelGameEngine::GetDroppedInputEvents() {
+  return nAtomInputDropped.load(std::memory_order_relaxed);
+}
+
+bool PixelGameEngine::PollInputEvent(InputEvent &e) {
+  if (nFrameInputPos >= vFrameInput.size())
+    return false;
+  e = vFrameInput[nFrameInputPos++];
+  return true;
+}
+
+void PixelGameEngine::olc_Terminate() {
+  bAtomActive = false;
+  olc_WakeIdle();
+}
+
+void PixelGameEngine::EngineThread() {
+  SMLND_TRACE_THREAD("engine");
+
+  // Start the graphics device, the context is owned by the game thread
+  if (pPlatform->CreateGraphics(pDefaultDrawTarget) != olc::OK)
     bAtomActive = false;
 
-  auto tp1 = std::chrono::system_clock::now();
-  auto tp2 = std::chrono::system_clock::now();
+  // Create user resources as part of this thread
+  {
+    SMLND_TRACE_SCOPE("OnUserCreate");
+    if (!OnUserCreate())
+      bAtomActive = false;
+  }
+  olc_OpenProfilerCounters();
+
+  auto tp1 = std::chrono::steady_clock::now();
+  auto tp2 = std::chrono::steady_clock::now();
+  tpNextFrame = tp1;
 
   while (bAtomActive) {
-    // Run as fast as possible
+    // Run as fast as the frame rate and idle mode allow
     while (bAtomActive) {
+      {
+        SMLND_TRACE_SCOPE("wait");
+        ProfileBegin(PROFILE_WAIT);
+        olc_WaitForFrame();
+        ProfileEnd(PROFILE_WAIT);
+      }
+      if (!bAtomActive)
+        break;
+      SMLND_TRACE_SCOPE("frame");
+      ProfileBegin(PROFILE_FRAME);
+
       // Handle Timing
-      tp2 = std::chrono::system_clock::now();
+      tp2 = std::chrono::steady_clock::now();
       std::chrono::duration<float> elapsedTime = tp2 - tp1;
       tp1 = tp2;
 
       // Our time per frame coefficient
       float fElapsedTime = elapsedTime.count();
 
-#ifndef _WIN32
-      // Handle Xlib Message Loop - we do this in the
-      // same thread that OpenGL was created so we dont
-      // need to worry too much about multithreading with X11
-      XEvent xev;
-      while (XPending(olc_Display)) {
-        XNextEvent(olc_Display, &xev);
-        if (xev.type == Expose) {
-          XWindowAttributes gwa;
-          XGetWindowAttributes(olc_Display, olc_Window, &gwa);
-          glViewport(0, 0, gwa.width, gwa.height);
-        } else if (xev.type == KeyPress) {
-          KeySym sym = XLookupKeysym(&xev.xkey, 0);
-          pKeyNewState[mapKeys[sym]] = true;
-        } else if (xev.type == KeyRelease) {
-          KeySym sym = XLookupKeysym(&xev.xkey, 0);
-          pKeyNewState[mapKeys[sym]] = false;
-        } else if (xev.type == ButtonPress) {
-          pMouseNewState[xev.xbutton.button - 1] = true;
-        } else if (xev.type == ButtonRelease) {
-          pMouseNewState[xev.xbutton.button - 1] = false;
-        } else if (xev.type == MotionNotify) {
-          olc_UpdateMouse(xev.xmotion.x, xev.xmotion.y);
-        } else if (xev.type == FocusIn) {
-          bHasInputFocus = true;
-        } else if (xev.type == FocusOut) {
-          bHasInputFocus = false;
-        } else if (xev.type == ClientMessage) {
-          bAtomActive = false;
-        }
-      }
-#endif
-
-      // Handle User Input - Keyboard
-      for (int i = 0; i < 256; i++) {
-        pKeyboardState[i].bPressed = false;
-        pKeyboardState[i].bReleased = false;
-
-        if (pKeyNewState[i] != pKeyOldState[i]) {
-          if (pKeyNewState[i]) {
-            pKeyboardState[i].bPressed = !pKeyboardState[i].bHeld;
-            pKeyboardState[i].bHeld = true;
-          } else {
-            pKeyboardState[i].bReleased = true;
-            pKeyboardState[i].bHeld = false;
-          }
-        }
-
-        pKeyOldState[i] = pKeyNewState[i];
+      // Handle platform events, this feeds the new input states
+      {
+        SMLND_TRACE_SCOPE("HandleSystemEvent");
+        ProfileBegin(PROFILE_EVENTS);
+        pPlatform->HandleSystemEvent();
+        ProfileEnd(PROFILE_EVENTS);
       }
 
-      // Handle User Input - Mouse
-      for (int i = 0; i < 5; i++) {
-        pMouseState[i].bPressed = false;
-        pMouseState[i].bReleased = false;
-
-        if (pMouseNewState[i] != pMouseOldState[i]) {
-          if (pMouseNewState[i]) {
-            pMouseState[i].bPressed = !pMouseState[i].bHeld;
-            pMouseState[i].bHeld = true;
-          } else {
-            pMouseState[i].bReleased = true;
-            pMouseState[i].bHeld = false;
-          }
-        }
-
-        pMouseOldState[i] = pMouseNewState[i];
+      // Handle User Input
+      {
+        SMLND_TRACE_SCOPE("olc_UpdateInput");
+        ProfileBegin(PROFILE_INPUT);
+        olc_UpdateInput();
+        ProfileEnd(PROFILE_INPUT);
       }
 
       // Handle Frame Update
-      if (!OnUserUpdate(fElapsedTime))
-        bAtomActive = false;
+      {
+        SMLND_TRACE_SCOPE("OnUserUpdate");
+        ProfileBegin(PROFILE_UPDATE);
+        if (!OnUserUpdate(fElapsedTime))
+          bAtomActive = false;
+        ProfileEnd(PROFILE_UPDATE);
+      }
 
       // Display Graphics
+      {
+        SMLND_TRACE_SCOPE("DisplayFrame");
+        bool bOverlay = pProfiler && bProfilerOverlay;
+        if (bOverlay)
+          olc_DrawProfilerOverlay();
+        pPlatform->DisplayFrame(pDefaultDrawTarget, dirtyScreen);
+        dirtyScreen.Reset();
+        if (bOverlay)
+          olc_RestoreProfilerOverlay();
+      }
 
-      // TODO: This is a bit slow (especially in debug, but 100x faster in release mode???)
-      // Copy pixel array into texture
-      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, nScreenWidth, nScreenHeight, GL_RGBA, GL_UNSIGNED_BYTE,
-          pDefaultDrawTarget->GetData());
-
-      // Display texture on screen
-      glBegin(GL_QUADS);
-      glTexCoord2f(0.0, 1.0);
-      glVertex3f(-1.0f, -1.0f, 0.0f);
-      glTexCoord2f(0.0, 0.0);
-      glVertex3f(-1.0f, 1.0f, 0.0f);
-      glTexCoord2f(1.0, 0.0);
-      glVertex3f(1.0f, 1.0f, 0.0f);
-      glTexCoord2f(1.0, 1.0);
-      glVertex3f(1.0f, -1.0f, 0.0f);
-      glEnd();
-
-      // Present Graphics to screen
-#ifdef _WIN32
-      SwapBuffers(glDeviceContext);
-#else
-      glXSwapBuffers(olc_Display, olc_Window);
-#endif
+      if (pProfiler) {
+        pProfiler->End(PROFILE_FRAME);
+        pProfiler->EndFrame();
+      }
 
       // Update Title Bar
       fFrameTimer += fElapsedTime;
       nFrameCount++;
       if (fFrameTimer >= 1.0f) {
         fFrameTimer -= 1.0f;
-#ifdef _WIN32
-#ifdef UNICODE
-        wchar_t sTitle[256];
-        swprintf(sTitle, 256, L"OneLoneCoder.com - Pixel Game Engine - %s - FPS: %d", wsAppName.c_str(), nFrameCount);
-#else
-#ifndef __MINGW32__
-        char sTitle[256];
-        sprintf_s(sTitle, 256, "OneLoneCoder.com - Pixel Game Engine - %s - FPS: %d", sAppName.c_str(), nFrameCount);
-#else
         char sTitle[256];
-        sprintf(sTitle, "OneLoneCoder.com - Pixel Game Engine - %s - FPS: %d", sAppName.c_str(), nFrameCount);
-#endif
-#endif
-        SetWindowText(olc_hWnd, sTitle);
-#else
-        char sTitle[256];
-        sprintf(sTitle, "OneLoneCoder.com - Pixel Game Engine - %s - FPS: %d", sAppName.c_str(), nFrameCount);
-        XStoreName(olc_Display, olc_Window, sTitle);
-#endif
+        snprintf(sTitle, 256, "OneLoneCoder.com - Pixel Game Engine - %s - FPS: %d", sAppName.c_str(), nFrameCount);
+        pPlatform->SetWindowTitle(sTitle);
         nFrameCount = 0;
       }
 
@@ -1091,15 +2015,7 @@ void PixelGameEngine::EngineThread() {
     }
   }
 
-#ifdef _WIN32
-  wglDeleteContext(glRenderContext);
-  PostMessage(olc_hWnd, WM_DESTROY, 0, 0);
-#else
-  glXMakeCurrent(olc_Display, None, NULL);
-  glXDestroyContext(olc_Display, glDeviceContext);
-  XDestroyWindow(olc_Display, olc_Window);
-  XCloseDisplay(olc_Display);
-#endif
+  pPlatform->DestroyGraphics();
 
 }
 
@@ -1142,9 +2058,175 @@ void PixelGameEngine::olc_ConstructFontSheet() {
   }
 }
 
+//==========================================================
+
+Platform_Null::Platform_Null(uint32_t nMaxFrames) {
+  this->nMaxFrames = nMaxFrames;
+}
+
+void Platform_Null::olc_PushEvent(const ScriptEvent &e) {
+  // Keep the script ordered by frame, events within a frame keep their order
+  auto it = listScript.begin();
+  while (it != listScript.end() && it->nFrame <= e.nFrame)
+    ++it;
+  listScript.insert(it, e);
+}
+
+void Platform_Null::PushKey(uint32_t nFrame, Key k, bool bDown) {
+  olc_PushEvent( { ScriptEvent::KEY, nFrame, (int32_t) k, bDown, 0, 0 });
+}
+
+void Platform_Null::PushMouseButton(uint32_t nFrame, uint32_t b, bool bDown) {
+  olc_PushEvent( { ScriptEvent::MOUSE_BUTTON, nFrame, (int32_t) b, bDown, 0, 0 });
+}
+
+void Platform_Null::PushMouseMove(uint32_t nFrame, int32_t x, int32_t y) {
+  olc_PushEvent( { ScriptEvent::MOUSE_MOVE, nFrame, 0, false, x, y });
+}
+
+void Platform_Null::PushKeyStroke(uint32_t nFrame, Key k) {
+  PushKey(nFrame, k, true);
+  PushKey(nFrame + 1, k, false);
+}
+
+void Platform_Null::PushClick(uint32_t nFrame, int32_t x, int32_t y, uint32_t b) {
+  PushMouseMove(nFrame, x, y);
+  PushMouseButton(nFrame, b, true);
+  PushMouseButton(nFrame + 1, b, false);
+}
+
+Sprite* Platform_Null::GetFrameBuffer() {
+  return pFrame;
+}
+
+uint32_t Platform_Null::GetFrameCount() {
+  return nFrameCount;
+}
+
+uint64_t Platform_Null::GetPresentedBytes() {
+  return nPresentedBytes;
+}
+
+olc::rcode Platform_Null::CreateWindowPane(PixelGameEngine *pge, uint32_t screen_w, uint32_t screen_h,
+    uint32_t pixel_w, uint32_t pixel_h) {
+  this->pge = pge;
+  nPixelWidth = pixel_w;
+  nPixelHeight = pixel_h;
+  return olc::OK;
+}
+
+olc::rcode Platform_Null::StartSystemEventLoop() {
+  return olc::OK;
+}
+
+olc::rcode Platform_Null::CreateGraphics(Sprite *frame) {
+  pFrame = frame;
+  nFrameCount = 0;
+  pge->olc_UpdateKeyFocus(true);
+  return olc::OK;
+}
+
+olc::rcode Platform_Null::HandleSystemEvent() {
+  while (!listScript.empty() && listScript.front().nFrame <= nFrameCount) {
+    const ScriptEvent &e = listScript.front();
+    switch (e.type) {
+    case ScriptEvent::KEY:
+      pge->olc_UpdateKeyState(e.nCode, e.bDown);
+      break;
+    case ScriptEvent::MOUSE_BUTTON:
+      pge->olc_UpdateMouseState(e.nCode, e.bDown);
+      break;
+    case ScriptEvent::MOUSE_MOVE:
+      // Scripts are written in "pixel" space, the engine expects screen space
+      pge->olc_UpdateMouse(e.x * nPixelWidth, e.y * nPixelHeight);
+      break;
+    }
+    listScript.pop_front();
+  }
+  return olc::OK;
+}
+
+void Platform_Null::DisplayFrame(Sprite *frame, const DirtyRegion &dirty) {
+  pFrame = frame;
+  nPresentedBytes += dirty.GetPixelCount() * sizeof(Pixel);
+  nFrameCount++;
+  if (nMaxFrames > 0 && nFrameCount >= nMaxFrames)
+    pge->olc_Terminate();
+}
+
+void Platform_Null::SetWindowTitle(const std::string &sTitle) {
+}
+
+olc::rcode Platform_Null::DestroyGraphics() {
+  return olc::OK;
+}
+
+//==========================================================
+
+#ifndef OLC_HEADLESS
+// Common to both native platforms, the frame buffer lives in a texture
+// that is stretched over the whole window
+
+olc::rcode Platform_Native::CreateGraphics(Sprite *frame) {
+  // Start OpenGL, the context is owned by the game thread
+  if (!olc_OpenGLCreate())
+    return olc::FAIL;
+
+  // Create Screen Texture - disable filtering
+  glEnable(GL_TEXTURE_2D);
+  glGenTextures(1, &glBuffer);
+  glBindTexture(GL_TEXTURE_2D, glBuffer);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, nScreenWidth, nScreenHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+      frame->GetData());
+  return olc::OK;
+}
+
+void Platform_Native::DisplayFrame(Sprite *frame, const DirtyRegion &dirty) {
+  // Copy only the changed bands of the pixel array into the texture, the
+  // rest of the texture still holds the previous frame
+  pge->ProfileBegin(PROFILE_UPLOAD);
+  dirty.GetBands(vBands);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->width);
+  for (auto &b : vBands)
+    glTexSubImage2D(GL_TEXTURE_2D, 0, b.x, b.y, b.w, b.h, GL_RGBA, GL_UNSIGNED_BYTE,
+        frame->GetData() + b.y * frame->width + b.x);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  pge->ProfileEnd(PROFILE_UPLOAD);
+
+  pge->ProfileBegin(PROFILE_SWAP);
+  // Display texture on screen
+  glBegin(GL_QUADS);
+  glTexCoord2f(0.0, 1.0);
+  glVertex3f(-1.0f, -1.0f, 0.0f);
+  glTexCoord2f(0.0, 0.0);
+  glVertex3f(-1.0f, 1.0f, 0.0f);
+  glTexCoord2f(1.0, 0.0);
+  glVertex3f(1.0f, 1.0f, 0.0f);
+  glTexCoord2f(1.0, 1.0);
+  glVertex3f(1.0f, -1.0f, 0.0f);
+  glEnd();
+
+  // Present Graphics to screen
 #ifdef _WIN32
-HWND PixelGameEngine::olc_WindowCreate()
+  SwapBuffers(glDeviceContext);
+#else
+  glXSwapBuffers(olc_Display, olc_Window);
+#endif
+  pge->ProfileEnd(PROFILE_SWAP);
+}
+
+#ifdef _WIN32
+olc::rcode Platform_Native::CreateWindowPane(PixelGameEngine *pge, uint32_t screen_w, uint32_t screen_h,
+    uint32_t pixel_w, uint32_t pixel_h)
 {
+  this->pge = pge;
+  nScreenWidth = screen_w;
+  nScreenHeight = screen_h;
+
   WNDCLASS wc;
   wc.hIcon = LoadIcon(NULL, IDI_APPLICATION);
   wc.hCursor = LoadCursor(NULL, IDC_ARROW);
@@ -1166,7 +2248,7 @@ HWND PixelGameEngine::olc_WindowCreate()
   // Define window furniture
   DWORD dwExStyle = WS_EX_APPWINDOW | WS_EX_WINDOWEDGE;
   DWORD dwStyle = WS_CAPTION | WS_SYSMENU | WS_VISIBLE;
-  RECT rWndRect = {0, 0, (LONG)nScreenWidth * (LONG)nPixelWidth, (LONG)nScreenHeight * (LONG)nPixelHeight};
+  RECT rWndRect = {0, 0, (LONG)screen_w * (LONG)pixel_w, (LONG)screen_h * (LONG)pixel_h};
 
   // Keep client size as requested
   AdjustWindowRectEx(&rWndRect, dwStyle, FALSE, dwExStyle);
@@ -1205,10 +2287,53 @@ HWND PixelGameEngine::olc_WindowCreate()
   mapKeys[0x30] = Key::K0; mapKeys[0x31] = Key::K1; mapKeys[0x32] = Key::K2; mapKeys[0x33] = Key::K3; mapKeys[0x34] = Key::K4;
   mapKeys[0x35] = Key::K5; mapKeys[0x36] = Key::K6; mapKeys[0x37] = Key::K7; mapKeys[0x38] = Key::K8; mapKeys[0x39] = Key::K9;
 
-  return olc_hWnd;
+  return olc_hWnd ? olc::OK : olc::FAIL;
+}
+
+olc::rcode Platform_Native::StartSystemEventLoop()
+{
+  // Handle Windows Message Loop
+  MSG msg;
+  while (GetMessage(&msg, NULL, 0, 0) > 0)
+  {
+    TranslateMessage(&msg);
+    DispatchMessage(&msg);
+  }
+  return olc::OK;
+}
+
+olc::rcode Platform_Native::HandleSystemEvent()
+{
+  // Messages are pumped by StartSystemEventLoop() on the main thread
+  return olc::OK;
+}
+
+void Platform_Native::SetWindowTitle(const std::string &sTitle)
+{
+#ifdef UNICODE
+#ifndef __MINGW32__
+  std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+  SetWindowText(olc_hWnd, converter.from_bytes(sTitle).c_str());
+#else
+  wchar_t *buffer = new wchar_t[sTitle.length() + 1];
+  mbstowcs(buffer, sTitle.c_str(), sTitle.length());
+  buffer[sTitle.length()] = L'\0';
+  SetWindowText(olc_hWnd, buffer);
+  delete [] buffer;
+#endif
+#else
+  SetWindowText(olc_hWnd, sTitle.c_str());
+#endif
+}
+
+olc::rcode Platform_Native::DestroyGraphics()
+{
+  wglDeleteContext(glRenderContext);
+  PostMessage(olc_hWnd, WM_DESTROY, 0, 0);
+  return olc::OK;
 }
 
-bool PixelGameEngine::olc_OpenGLCreate()
+bool Platform_Native::olc_OpenGLCreate()
 {
   // Create Device Context
   glDeviceContext = GetDC(olc_hWnd);
@@ -1234,35 +2359,42 @@ bool PixelGameEngine::olc_OpenGLCreate()
 }
 
 // Windows Event Handler
-LRESULT CALLBACK PixelGameEngine::olc_WindowEvent(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+LRESULT CALLBACK Platform_Native::olc_WindowEvent(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
-  static PixelGameEngine *sge;
+  static Platform_Native *sp;
   switch (uMsg)
   {
-    case WM_CREATE: sge = (PixelGameEngine*)((LPCREATESTRUCT)lParam)->lpCreateParams; return 0;
-    case WM_MOUSEMOVE: sge->olc_UpdateMouse(LOWORD(lParam), HIWORD(lParam)); return 0;
-    case WM_SETFOCUS: sge->bHasInputFocus = true; return 0;
-    case WM_KILLFOCUS: sge->bHasInputFocus = false; return 0;
-    case WM_KEYDOWN: sge->pKeyNewState[mapKeys[wParam]] = true; return 0;
-    case WM_KEYUP: sge->pKeyNewState[mapKeys[wParam]] = false; return 0;
-    case WM_LBUTTONDOWN:sge->pMouseNewState[0] = true; return 0;
-    case WM_LBUTTONUP: sge->pMouseNewState[0] = false; return 0;
-    case WM_RBUTTONDOWN:sge->pMouseNewState[1] = true; return 0;
-    case WM_RBUTTONUP: sge->pMouseNewState[1] = false; return 0;
-    case WM_MBUTTONDOWN:sge->pMouseNewState[2] = true; return 0;
-    case WM_MBUTTONUP: sge->pMouseNewState[2] = false; return 0;
-    case WM_CLOSE: bAtomActive = false; return 0;
+    case WM_CREATE: sp = (Platform_Native*)((LPCREATESTRUCT)lParam)->lpCreateParams; return 0;
+    case WM_MOUSEMOVE: sp->pge->olc_UpdateMouse(LOWORD(lParam), HIWORD(lParam)); return 0;
+    case WM_SETFOCUS: sp->pge->olc_UpdateKeyFocus(true); return 0;
+    case WM_KILLFOCUS: sp->pge->olc_UpdateKeyFocus(false); return 0;
+    case WM_KEYDOWN: sp->pge->olc_UpdateKeyState(mapKeys[wParam], true); return 0;
+    case WM_KEYUP: sp->pge->olc_UpdateKeyState(mapKeys[wParam], false); return 0;
+    case WM_LBUTTONDOWN:sp->pge->olc_UpdateMouseState(0, true); return 0;
+    case WM_LBUTTONUP: sp->pge->olc_UpdateMouseState(0, false); return 0;
+    case WM_RBUTTONDOWN:sp->pge->olc_UpdateMouseState(1, true); return 0;
+    case WM_RBUTTONUP: sp->pge->olc_UpdateMouseState(1, false); return 0;
+    case WM_MBUTTONDOWN:sp->pge->olc_UpdateMouseState(2, true); return 0;
+    case WM_MBUTTONUP: sp->pge->olc_UpdateMouseState(2, false); return 0;
+    case WM_CLOSE: sp->pge->olc_Terminate(); return 0;
     case WM_DESTROY: PostQuitMessage(0); return 0;
   }
   return DefWindowProc(hWnd, uMsg, wParam, lParam);
 }
 #else
 // Do the Linux stuff!
-Display* PixelGameEngine::olc_WindowCreate() {
+olc::rcode Platform_Native::CreateWindowPane(PixelGameEngine *pge, uint32_t screen_w, uint32_t screen_h,
+    uint32_t pixel_w, uint32_t pixel_h) {
+  this->pge = pge;
+  nScreenWidth = screen_w;
+  nScreenHeight = screen_h;
+
   XInitThreads();
 
-  // Grab the default display and window
+  // Grab the default display and window, there may not be one
   olc_Display = XOpenDisplay(NULL);
+  if (olc_Display == nullptr)
+    return olc::FAIL;
   olc_WindowRoot = DefaultRootWindow(olc_Display);
 
   // Based on the display capabilities, configure the appearance of the window
@@ -1276,8 +2408,8 @@ Display* PixelGameEngine::olc_WindowCreate() {
       | PointerMotionMask | FocusChangeMask;
 
   // Create the window
-  olc_Window = XCreateWindow(olc_Display, olc_WindowRoot, 30, 30, nScreenWidth * nPixelWidth,
-      nScreenHeight * nPixelHeight, 0, olc_VisualInfo->depth, InputOutput, olc_VisualInfo->visual,
+  olc_Window = XCreateWindow(olc_Display, olc_WindowRoot, 30, 30, screen_w * pixel_w,
+      screen_h * pixel_h, 0, olc_VisualInfo->depth, InputOutput, olc_VisualInfo->visual,
       CWColormap | CWEventMask, &olc_SetWindowAttribs);
 
   Atom wmDelete = XInternAtom(olc_Display, "WM_DELETE_WINDOW", true);
@@ -1361,10 +2493,61 @@ Display* PixelGameEngine::olc_WindowCreate() {
   mapKeys[XK_8] = Key::K8;
   mapKeys[XK_9] = Key::K9;
 
-  return olc_Display;
+  return olc::OK;
+}
+
+olc::rcode Platform_Native::StartSystemEventLoop() {
+  // Xlib events are pumped from the engine thread, see HandleSystemEvent()
+  return olc::OK;
+}
+
+olc::rcode Platform_Native::HandleSystemEvent() {
+  // Handle Xlib Message Loop - we do this in the
+  // same thread that OpenGL was created so we dont
+  // need to worry too much about multithreading with X11
+  XEvent xev;
+  while (XPending(olc_Display)) {
+    XNextEvent(olc_Display, &xev);
+    if (xev.type == Expose) {
+      XWindowAttributes gwa;
+      XGetWindowAttributes(olc_Display, olc_Window, &gwa);
+      glViewport(0, 0, gwa.width, gwa.height);
+    } else if (xev.type == KeyPress) {
+      KeySym sym = XLookupKeysym(&xev.xkey, 0);
+      pge->olc_UpdateKeyState(mapKeys[sym], true);
+    } else if (xev.type == KeyRelease) {
+      KeySym sym = XLookupKeysym(&xev.xkey, 0);
+      pge->olc_UpdateKeyState(mapKeys[sym], false);
+    } else if (xev.type == ButtonPress) {
+      pge->olc_UpdateMouseState(xev.xbutton.button - 1, true);
+    } else if (xev.type == ButtonRelease) {
+      pge->olc_UpdateMouseState(xev.xbutton.button - 1, false);
+    } else if (xev.type == MotionNotify) {
+      pge->olc_UpdateMouse(xev.xmotion.x, xev.xmotion.y);
+    } else if (xev.type == FocusIn) {
+      pge->olc_UpdateKeyFocus(true);
+    } else if (xev.type == FocusOut) {
+      pge->olc_UpdateKeyFocus(false);
+    } else if (xev.type == ClientMessage) {
+      pge->olc_Terminate();
+    }
+  }
+  return olc::OK;
+}
+
+void Platform_Native::SetWindowTitle(const std::string &sTitle) {
+  XStoreName(olc_Display, olc_Window, sTitle.c_str());
+}
+
+olc::rcode Platform_Native::DestroyGraphics() {
+  glXMakeCurrent(olc_Display, None, NULL);
+  glXDestroyContext(olc_Display, glDeviceContext);
+  XDestroyWindow(olc_Display, olc_Window);
+  XCloseDisplay(olc_Display);
+  return olc::OK;
 }
 
-bool PixelGameEngine::olc_OpenGLCreate() {
+bool Platform_Native::olc_OpenGLCreate() {
   glDeviceContext = glXCreateContext(olc_Display, olc_VisualInfo, nullptr, GL_TRUE);
   glXMakeCurrent(olc_Display, olc_Window, glDeviceContext);
 
@@ -1387,10 +2570,12 @@ bool PixelGameEngine::olc_OpenGLCreate() {
 
 #endif
 
+std::map<uint16_t, uint8_t> Platform_Native::mapKeys;
+#endif
+
 // Need a couple of statics as these are singleton instances
 // read from multiple locations
 std::atomic<bool> PixelGameEngine::bAtomActive { false };
-std::map<uint16_t, uint8_t> PixelGameEngine::mapKeys;
 olc::PixelGameEngine* olc::PGEX::pge = nullptr;
 //=============================================================
 }
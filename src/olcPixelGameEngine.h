@@ -146,20 +146,24 @@
 #include <windows.h>
 #include <gdiplus.h>
 
+#ifndef OLC_HEADLESS
 // OpenGL Extension
 #include <GL/gl.h>
 typedef BOOL(WINAPI wglSwapInterval_t) (int interval);
 static wglSwapInterval_t *wglSwapInterval;
+#endif
 #else
+#ifndef OLC_HEADLESS
 #include <GL/gl.h>
 #include <GL/glx.h>
 #include <X11/X.h>
 #include <X11/Xlib.h>
-#include <png.h>
 
 typedef int (glSwapInterval_t)(Display *dpy, GLXDrawable drawable, int interval);
 static glSwapInterval_t *glSwapIntervalEXT;
 #endif
+#include <png.h>
+#endif
 
 // Standard includes
 #include <cmath>
@@ -172,13 +176,26 @@ static glSwapInterval_t *glSwapIntervalEXT;
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <mutex>
 #include <fstream>
 #include <map>
+#include <algorithm>
 
 #ifndef __MINGW32__
 #include <codecvt> // Need GCC 5.1+ people...
 #endif
 
+// SIMD alpha blending, SSE2 is part of every x86-64 target, AVX2 is
+// compiled in where the compiler allows it and picked at runtime
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OLC_BLEND_SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OLC_BLEND_AVX2
+#endif
+#endif
+
 #undef min
 #undef max
 
@@ -223,12 +240,72 @@ enum rcode {
 
 //=============================================================
 
+// Alpha blend kernels. Blends n src pixels over dst by src alpha scaled by
+// nBlend (0..255); the result is opaque. All kernels give identical results
+enum BlendKernel {
+  BLEND_SCALAR, BLEND_SSE2, BLEND_AVX2
+};
+typedef void (*BlendSpanFunc)(Pixel *dst, const Pixel *src, int32_t n, uint8_t nBlend);
+// Returns the requested kernel, nullptr if this build or CPU can't run it
+BlendSpanFunc GetBlendSpanKernel(BlendKernel k);
+// Returns the fastest kernel available on this CPU
+BlendSpanFunc GetBlendSpanKernel();
+
+//=============================================================
+
 struct HWButton {
   bool bPressed = false;	// Set once during the frame the event occurs
   bool bReleased = false;	// Set once during the frame the event occurs
   bool bHeld = false;		// Set tru for all frames between pressed and released events
 };
 
+// One change of input, stamped when the platform reported it
+struct InputEvent {
+  enum Type {
+    KEY, MOUSE_BUTTON, MOUSE_MOVE, FOCUS
+  } type;
+  int32_t nCode;		// Key or mouse button
+  bool bDown;			// Pressed, or focus gained
+  int32_t x, y;			// Mouse position in "pixel" space when it happened
+  std::chrono::steady_clock::time_point tp;
+};
+
+// A fixed size queue for one producer thread and one consumer thread,
+// neither side takes a lock. N must be a power of two
+template<typename T, uint32_t N>
+class SpscQueue {
+  static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+  // Producer side, returns false and drops t if the queue is full
+  bool Push(const T &t) {
+    uint32_t nTail = nAtomTail.load(std::memory_order_relaxed);
+    if (nTail - nAtomHead.load(std::memory_order_acquire) == N)
+      return false;
+    pBuffer[nTail & (N - 1)] = t;
+    nAtomTail.store(nTail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns false if the queue is empty
+  bool Pop(T &t) {
+    uint32_t nHead = nAtomHead.load(std::memory_order_relaxed);
+    if (nHead == nAtomTail.load(std::memory_order_acquire))
+      return false;
+    t = pBuffer[nHead & (N - 1)];
+    nAtomHead.store(nHead + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  // Head and tail sit on separate cache lines so the two threads don't
+  // invalidate each other's line on every push and pop
+  std::atomic<uint32_t> nAtomHead { 0 };
+  char pPadding[64];
+  std::atomic<uint32_t> nAtomTail { 0 };
+  T pBuffer[N];
+};
+
 //=============================================================
 
 // A bitmap-like structure that stores a 2D array of Pixels
@@ -241,20 +318,35 @@ public:
 
 public:
   olc::rcode LoadFromFile(std::string sImageFile);
+  // Raw sprite files, as written by SaveToSprFile, are mapped into memory rather than decoded.
+  // Pages are shared with the file cache until the sprite is drawn on, the file is never written.
   olc::rcode LoadFromSprFile(std::string sImageFile);
+  // The same format already in memory, e.g. inside a larger mapped file. The sprite uses the
+  // pixels in place and never frees them, they must outlive it.
+  olc::rcode LoadFromSprMemory(void *pData, size_t nSize);
+  olc::rcode SaveToSprFile(std::string sImageFile);
+  olc::rcode SaveToSprFile(std::ostream &os);
 
 public:
   int32_t width = 0;
   int32_t height = 0;
+  int32_t cellWidth = 0;   // Size of the cells of a sheet, kept in sprite files, 0 if not split
+  int32_t cellHeight = 0;
 
 public:
   Pixel GetPixel(int32_t x, int32_t y);
   void SetPixel(int32_t x, int32_t y, Pixel p);
   Pixel Sample(float x, float y);
   Pixel* GetData();
+  bool IsMapped() const { return pMapping != nullptr; }
 
 private:
   Pixel *pColData = nullptr;
+  void *pMapping = nullptr;
+  size_t nMappingSize = 0;
+  bool bBorrowed = false;
+
+  void olc_Release();
 
 };
 
@@ -332,17 +424,289 @@ enum Key {
 
 //=============================================================
 
+// The parts of the screen changed since the last presented frame, kept as
+// one inclusive x range per row. Platforms present it as bands of rows
+class DirtyRegion {
+public:
+  struct Band {
+    int32_t x, y, w, h;
+  };
+
+public:
+  void Resize(int32_t w, int32_t h);
+  // Marks (x1,y1) to (x2,y2) inclusive, clipped to the screen
+  void Add(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+  void AddAll();
+  void Reset();
+  bool IsEmpty() const;
+  // Consecutive dirty rows whose x ranges overlap are merged into one band
+  void GetBands(std::vector<Band> &vBands) const;
+  // Number of pixels in the bands, what a partial upload would transfer
+  uint32_t GetPixelCount() const;
+
+private:
+  int32_t nWidth = 0;
+  int32_t nHeight = 0;
+  int32_t nMinY = 0;
+  int32_t nMaxY = -1;
+  std::vector<int32_t> vRowMin;
+  std::vector<int32_t> vRowMax;
+};
+
+//=============================================================
+
+// The parts of a frame the profiler times. The engine times its own
+// phases, USER_UPDATE and USER_DRAW are for the application to mark
+// inside OnUserUpdate(), UPLOAD and SWAP for the platform inside
+// DisplayFrame(). FRAME is everything but WAIT, the scheduler's sleep
+enum ProfilePhase {
+  PROFILE_EVENTS,
+  PROFILE_INPUT,
+  PROFILE_UPDATE,
+  PROFILE_USER_UPDATE,
+  PROFILE_USER_DRAW,
+  PROFILE_UPLOAD,
+  PROFILE_SWAP,
+  PROFILE_FRAME,
+  PROFILE_WAIT,
+  PROFILE_PHASES
+};
+
+// Hardware events counted alongside the phase timings, user space only
+enum PerfCounter {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_COUNTERS
+};
+
+// A Linux perf_event_open() group counting the PerfCounter events of the
+// thread that opened it. Events the CPU or kernel don't offer are left out
+// and read as zero; if none can be opened, e.g. perf_event_paranoid or a
+// container forbids it, Open() fails and GetError() says why. Elsewhere
+// than Linux Open() always fails
+class PerfCounterGroup {
+public:
+  ~PerfCounterGroup();
+
+public:
+  bool Open();
+  void Close();
+  bool IsOpen() const;
+  bool IsAvailable(PerfCounter c) const;
+  // Running totals, scaled up if the kernel had to multiplex the group.
+  // False, with nCount untouched, if the group can't be read
+  bool Read(uint64_t nCount[PERF_COUNTERS]);
+  const std::string& GetError() const;
+  static const char* GetCounterName(PerfCounter c);
+
+private:
+  int nFd[PERF_COUNTERS] = { -1, -1, -1, -1, -1 };
+  int nLeader = -1;
+  // Position of each open counter in the group's read() layout
+  int nSlot[PERF_COUNTERS] = { -1, -1, -1, -1, -1 };
+  int nOpen = 0;
+  std::string sError;
+};
+
+// Per phase timings of the last nWindow frames, and optionally every
+// frame's timings streamed to a CSV file. Times are in microseconds.
+// With OpenCounters() each phase also gets PerfCounter totals
+class FrameProfiler {
+public:
+  struct Stats {
+    float fMin, fAvg, fP99;
+  };
+
+public:
+  // Timings of one phase add up when it is entered more than once a frame
+  void Begin(ProfilePhase p);
+  void End(ProfilePhase p);
+  // Closes the frame's timings into the window and the CSV file
+  void EndFrame();
+  Stats GetStats(ProfilePhase p) const;
+  uint32_t GetFrameCount() const;
+  bool OpenCsv(const std::string &sFile);
+  static const char* GetPhaseName(ProfilePhase p);
+
+  // Counts the calling thread from here on, call it from the thread that
+  // runs the phases. Before the first EndFrame() so the CSV has the columns
+  bool OpenCounters();
+  const PerfCounterGroup& GetCounters() const;
+  // Mean count per frame over the window
+  double GetCounterAvg(ProfilePhase p, PerfCounter c) const;
+
+private:
+  static const uint32_t nWindow = 256;
+  std::chrono::steady_clock::time_point tpBegin[PROFILE_PHASES];
+  float fFrame[PROFILE_PHASES] = { };
+  float fWindow[PROFILE_PHASES][nWindow] = { };
+  uint32_t nFrames = 0;
+  std::ofstream fileCsv;
+
+  PerfCounterGroup counters;
+  uint64_t nCountBegin[PROFILE_PHASES][PERF_COUNTERS] = { };
+  uint64_t nCountFrame[PROFILE_PHASES][PERF_COUNTERS] = { };
+  uint64_t nCountWindow[PROFILE_PHASES][PERF_COUNTERS][nWindow] = { };
+};
+
+//=============================================================
+
+class PixelGameEngine;
+
+// A Platform presents the engine's frame buffer and feeds input back into
+// the engine. The engine owns the frame buffer and the game loop; the
+// platform only decides where the pixels go and where events come from.
+class Platform {
+public:
+  virtual ~Platform() {
+  }
+
+public:
+  // Called from Start() on the calling thread, create the window here
+  virtual olc::rcode CreateWindowPane(PixelGameEngine *pge, uint32_t screen_w, uint32_t screen_h, uint32_t pixel_w,
+      uint32_t pixel_h) = 0;
+  // Called from Start() on the calling thread, blocks until the window closes
+  virtual olc::rcode StartSystemEventLoop() = 0;
+  // Called on the engine thread before OnUserCreate(), create the graphics context here
+  virtual olc::rcode CreateGraphics(Sprite *frame) = 0;
+  // Called on the engine thread once per frame, before input is processed
+  virtual olc::rcode HandleSystemEvent() = 0;
+  // Called on the engine thread once per frame, after OnUserUpdate(). Only
+  // the dirty region of frame has changed since the previous call
+  virtual void DisplayFrame(Sprite *frame, const DirtyRegion &dirty) = 0;
+  // Called on the engine thread about once a second with the current FPS
+  virtual void SetWindowTitle(const std::string &sTitle) = 0;
+  // Called on the engine thread after OnUserDestroy() allows shut down
+  virtual olc::rcode DestroyGraphics() = 0;
+
+protected:
+  PixelGameEngine *pge = nullptr;
+};
+
+// A platform with no window or graphics device. Frames are rendered into
+// memory only, input is replayed from a script queued before Start().
+// Script input is tied to frame numbers, so it never wakes an idle engine.
+class Platform_Null : public Platform {
+public:
+  // nMaxFrames = 0 runs until OnUserUpdate() returns false
+  Platform_Null(uint32_t nMaxFrames = 0);
+
+public:
+  // Script input, applied at the start of the given frame (first frame is 0)
+  void PushKey(uint32_t nFrame, Key k, bool bDown);
+  void PushMouseButton(uint32_t nFrame, uint32_t b, bool bDown);
+  void PushMouseMove(uint32_t nFrame, int32_t x, int32_t y);
+  // Convenience, a press and release on consecutive frames
+  void PushKeyStroke(uint32_t nFrame, Key k);
+  void PushClick(uint32_t nFrame, int32_t x, int32_t y, uint32_t b = 0);
+  // The last frame presented, this is the engine's primary draw target
+  Sprite* GetFrameBuffer();
+  // Number of frames presented so far
+  uint32_t GetFrameCount();
+  // Total bytes a partial upload would have sent for the frames presented
+  uint64_t GetPresentedBytes();
+
+public:
+  olc::rcode CreateWindowPane(PixelGameEngine *pge, uint32_t screen_w, uint32_t screen_h, uint32_t pixel_w,
+      uint32_t pixel_h) override;
+  olc::rcode StartSystemEventLoop() override;
+  olc::rcode CreateGraphics(Sprite *frame) override;
+  olc::rcode HandleSystemEvent() override;
+  void DisplayFrame(Sprite *frame, const DirtyRegion &dirty) override;
+  void SetWindowTitle(const std::string &sTitle) override;
+  olc::rcode DestroyGraphics() override;
+
+private:
+  struct ScriptEvent {
+    enum Type {
+      KEY, MOUSE_BUTTON, MOUSE_MOVE
+    } type;
+    uint32_t nFrame;
+    int32_t nCode;
+    bool bDown;
+    int32_t x, y;
+  };
+
+  std::list<ScriptEvent> listScript;
+  uint32_t nMaxFrames = 0;
+  uint32_t nFrameCount = 0;
+  uint64_t nPresentedBytes = 0;
+  uint32_t nPixelWidth = 1;
+  uint32_t nPixelHeight = 1;
+  Sprite *pFrame = nullptr;
+
+  void olc_PushEvent(const ScriptEvent &e);
+};
+
+#ifndef OLC_HEADLESS
+// The native window and OpenGL presentation, Win32/WGL or X11/GLX
+class Platform_Native : public Platform {
+public:
+  olc::rcode CreateWindowPane(PixelGameEngine *pge, uint32_t screen_w, uint32_t screen_h, uint32_t pixel_w,
+      uint32_t pixel_h) override;
+  olc::rcode StartSystemEventLoop() override;
+  olc::rcode CreateGraphics(Sprite *frame) override;
+  olc::rcode HandleSystemEvent() override;
+  void DisplayFrame(Sprite *frame, const DirtyRegion &dirty) override;
+  void SetWindowTitle(const std::string &sTitle) override;
+  olc::rcode DestroyGraphics() override;
+
+private:
+  uint32_t nScreenWidth = 0;
+  uint32_t nScreenHeight = 0;
+  static std::map<uint16_t, uint8_t> mapKeys;
+
+#ifdef _WIN32
+  HDC glDeviceContext = nullptr;
+  HGLRC glRenderContext = nullptr;
+#else
+  GLXContext glDeviceContext = nullptr;
+  GLXContext glRenderContext = nullptr;
+#endif
+  GLuint glBuffer;
+  std::vector<DirtyRegion::Band> vBands;
+
+  bool olc_OpenGLCreate();
+
+#ifdef _WIN32
+  // Windows specific window handling
+  HWND olc_hWnd = nullptr;
+  static LRESULT CALLBACK olc_WindowEvent(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+#else
+  // Non-Windows specific window handling
+  Display* olc_Display = nullptr;
+  Window olc_WindowRoot;
+  Window olc_Window;
+  XVisualInfo* olc_VisualInfo;
+  Colormap olc_ColourMap;
+  XSetWindowAttributes olc_SetWindowAttribs;
+#endif
+};
+#endif
+
+//=============================================================
+
 class PixelGameEngine {
 
 public:
   PixelGameEngine();
   virtual ~PixelGameEngine() {
+    if (bOwnsPlatform)
+      delete pPlatform;
+    delete pProfiler;
   }
 
 public:
+  // framerate caps the frame rate, -1 runs as fast as possible
   olc::rcode Construct(uint32_t screen_w, uint32_t screen_h, uint32_t pixel_w, uint32_t pixel_h,
       int32_t framerate = -1);
   olc::rcode Start();
+  // Use the given platform instead of the native window, call before Start().
+  // The engine does not take ownership of the platform.
+  void SetPlatform(Platform *platform);
 
 public:
   // Override Interfaces
@@ -365,6 +729,13 @@ public:
   int32_t GetMouseX();
   // Get Mouse Y coordinate in "pixel" space
   int32_t GetMouseY();
+  // Returns the input events of this frame one at a time, in the order they
+  // happened, false when there are no more. The button states above are
+  // derived from the same events, but events don't merge two clicks in one frame
+  bool PollInputEvent(InputEvent &e);
+  // Returns how many input events were lost because the queue was full,
+  // i.e. the engine thread fell more than the queue size behind
+  uint32_t GetDroppedInputEvents();
 
 public:
   // Utility
@@ -379,6 +750,31 @@ public:
   // Returns the currently active draw target
   Sprite* GetDrawTarget();
 
+public:
+  // Frame Scheduling
+  // Caps the frame rate, frames are paced by sleeping. <= 0 removes the cap
+  void SetFrameRate(int32_t framerate);
+  // In idle mode a frame is only produced when input arrives or one has
+  // been requested, otherwise frames run continuously
+  void SetIdleMode(bool bIdle);
+  // Asks for another frame in fDelay seconds, or as soon as the frame rate
+  // allows. Requests last for one frame, so ask again each frame as needed
+  void RequestFrame(float fDelay = 0.0f);
+
+public:
+  // Profiling
+  // Times the phases of every frame, and writes each frame's timings to
+  // sCsvFile if one is given. Returns false if the file can't be created.
+  // bCounters adds hardware counters per phase where the system allows
+  bool EnableProfiler(bool bEnable, const std::string &sCsvFile = "", bool bCounters = false);
+  FrameProfiler* GetProfiler();
+  // Shows min/avg/p99 of each phase over recent frames, top left
+  void ShowProfilerOverlay(bool bShow);
+  bool IsProfilerOverlayShown();
+  // Mark a phase of the frame, does nothing unless profiling is enabled
+  void ProfileBegin(ProfilePhase p);
+  void ProfileEnd(ProfilePhase p);
+
 public:
   // Draw Routines
   // Specify which Sprite should be the target of drawing functions, use nullptr
@@ -389,6 +785,8 @@ public:
   // olc::Pixel::MASK   = Transparent if alpha is < 255
   // olc::Pixel::ALPHA  = Full transparency
   void SetPixelMode(Pixel::Mode m);
+  // Returns the current pixel mode
+  Pixel::Mode GetPixelMode();
   // Change the blend factor form between 0.0f to 1.0f;
   void SetPixelBlend(float fBlend);
 
@@ -413,10 +811,28 @@ public:
   // Draws an area of a sprite at location (x,y), where the
   // selected area is (ox,oy) to (ox+w,oy+h)
   void DrawPartialSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h);
+  // Draws an area of a sprite rotated clockwise by fAngle degrees about its centre,
+  // with the centre placed at (x,y). The selected area is (ox,oy) to (ox+w,oy+h)
+  void DrawRotatedPartialSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h,
+      float fAngle);
   // Draws a single line of text
   void DrawString(int32_t x, int32_t y, std::string sText, Pixel col = olc::WHITE, uint32_t scale = 1);
   // Clears entire draw target to Pixel
   void Clear(Pixel p);
+  // Marks an area of the screen as changed, for writes made directly into
+  // the screen's pixel data. Draw routines mark their own output
+  void MarkDirty(int32_t x, int32_t y, int32_t w, int32_t h);
+
+public:
+  // Platform Interfaces
+  // Called by the active Platform to feed input into the engine. Mouse
+  // coordinates arrive in screen space and are stored in "pixel" space
+  void olc_UpdateMouse(int32_t x, int32_t y);
+  void olc_UpdateMouseState(int32_t button, bool state);
+  void olc_UpdateKeyState(int32_t key, bool state);
+  void olc_UpdateKeyFocus(bool state);
+  // Requests the engine to shut down at the end of the current frame
+  void olc_Terminate();
 
 public:
   // Branding
@@ -428,6 +844,10 @@ private:
   Sprite *pDrawTarget = nullptr;
   Pixel::Mode nPixelMode = Pixel::NORMAL;
   float fBlendFactor = 1.0f;
+  uint8_t nBlendFactor = 255;
+  BlendSpanFunc pBlendSpan = nullptr;
+  std::vector<Pixel> vSpanBuffer;
+  DirtyRegion dirtyScreen;
   uint32_t nScreenWidth = 256;
   uint32_t nScreenHeight = 240;
   uint32_t nPixelWidth = 4;
@@ -438,53 +858,63 @@ private:
   float fFrameTimer = 1.0f;
   int nFrameCount = 0;
   float fFramePeriod = 0.0f;
+  bool bIdleMode = false;
+  bool bFrameRequested = true;
+  std::chrono::steady_clock::time_point tpFrameRequested;
+  std::chrono::steady_clock::time_point tpNextFrame;
+  std::atomic<bool> bAtomInput { false };
+  std::mutex muxIdle;
+  std::condition_variable cvIdle;
+  FrameProfiler *pProfiler = nullptr;
+  bool bProfilerOverlay = false;
+  bool bProfilerCounters = false;
+  std::vector<Pixel> vOverlaySave;
   Sprite *fontSprite = nullptr;
 
-  static std::map<uint16_t, uint8_t> mapKeys;
-  bool pKeyNewState[256] { 0 };
-  bool pKeyOldState[256] { 0 };
   HWButton pKeyboardState[256];
-
-  bool pMouseNewState[5] { 0 };
-  bool pMouseOldState[5] { 0 };
   HWButton pMouseState[5];
 
-#ifdef _WIN32
-  HDC glDeviceContext = nullptr;
-  HGLRC glRenderContext = nullptr;
-#else
-  GLXContext glDeviceContext = nullptr;
-  GLXContext glRenderContext = nullptr;
-#endif
-  GLuint glBuffer;
+  // Events travel from the platform's event thread to the engine thread
+  SpscQueue<InputEvent, 1024> queueInput;
+  std::atomic<uint32_t> nAtomInputDropped { 0 };
+  std::vector<InputEvent> vFrameInput;
+  size_t nFrameInputPos = 0;
+  int32_t nInputMouseX = 0;
+  int32_t nInputMouseY = 0;
+
+  Platform *pPlatform = nullptr;
+  bool bOwnsPlatform = false;
 
   void EngineThread();
+  // Sleeps until the next frame is due, see SetFrameRate() and SetIdleMode()
+  void olc_WaitForFrame();
+  // Called when input arrives, wakes the engine thread if it is idle
+  void olc_WakeIdle();
+  // Producer side, queues an input event stamped with the current time
+  void olc_PushInput(InputEvent::Type type, int32_t nCode, bool bDown);
+  // Consumer side, drains the queue into this frame's events and states
+  void olc_UpdateInput();
+  // Draws the profiler overlay over the screen, keeping what was beneath it
+  // so olc_RestoreProfilerOverlay() can put it back after presenting
+  void olc_DrawProfilerOverlay();
+  void olc_RestoreProfilerOverlay();
+  void olc_OpenProfilerCounters();
 
   // If anything sets this flag to false, the engine
   // "should" shut down gracefully
   static std::atomic<bool> bAtomActive;
 
   // Common initialisation functions
-  void olc_UpdateMouse(uint32_t x, uint32_t y);
-  bool olc_OpenGLCreate();
   void olc_ConstructFontSheet();
 
-#ifdef _WIN32
-  // Windows specific window handling
-  HWND olc_hWnd = nullptr;
-  HWND olc_WindowCreate();
-  std::wstring wsAppName;
-  static LRESULT CALLBACK olc_WindowEvent(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
-#else
-  // Non-Windows specific window handling
-  Display* olc_Display = nullptr;
-  Window olc_WindowRoot;
-  Window olc_Window;
-  XVisualInfo* olc_VisualInfo;
-  Colormap olc_ColourMap;
-  XSetWindowAttributes olc_SetWindowAttribs;
-  Display* olc_WindowCreate();
-#endif
+  // Span functions for the current pixel mode, chosen once per primitive
+  typedef BlendSpanFunc SpanFunc;
+  typedef void (*FillFunc)(Pixel *dst, int32_t n, Pixel p, uint8_t nBlend);
+  SpanFunc olc_GetCopySpan();
+  FillFunc olc_GetFillSpan(Pixel::Mode m);
+  void olc_FillRow(FillFunc fill, int32_t x1, int32_t x2, int32_t y, Pixel p);
+  // Marks (x1,y1) to (x2,y2) inclusive as changed if drawing to the screen
+  void olc_MarkDirty(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
 
 };
 
@@ -0,0 +1,182 @@
+/*
+ * smlnd_arena.hpp
+ *
+ *  Created on: 16 Oct 2026
+ *      Author: steve
+ */
+
+/*************************************************************************
+ * Doxygen documentation
+ *************************************************************************/
+
+/*! @file smlnd_arena.hpp
+ *  @brief Summerland header for a monotonic arena allocator.
+ *
+ */
+/*! @defgroup smlnd_arena
+ *  Memory for objects that all die together. Allocation bumps a pointer through large blocks,
+ *  freeing single objects does nothing, and reset() drops everything at once.
+ *
+ *  After a reset that needed more than one block the arena keeps a single block big enough for all
+ *  of it, so refilling it with a similar load takes no further memory from the system.
+ *
+ *  ArenaAllocator<T> lets standard containers allocate from an arena.
+ */
+
+
+#ifndef SMLND_ARENA_HPP_
+#define SMLND_ARENA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace smlnd {
+
+class Arena {
+
+public:
+  /**
+   * Running totals since the arena was made.
+   */
+  struct Stats {
+    uint64_t allocations = 0;   // allocate() calls
+    uint64_t bytes = 0;         // bytes handed out by allocate()
+    uint64_t blocks = 0;        // blocks taken from the system
+    uint64_t resets = 0;
+  };
+
+private:
+  struct Block {
+    char* data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks;
+  size_t used = 0;              // in the last block
+  size_t total = 0;             // handed out since the last reset, with alignment
+  size_t blockSize;
+  Stats stats;
+
+public:
+  explicit Arena(const size_t blockSize = 64 * 1024) :
+      blockSize(blockSize) {
+  }
+
+  ~Arena() {
+    for (Block& block : this->blocks)
+      free(block.data);
+  }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /**
+   * Returns size bytes aligned to align, a power of two no larger than alignof(std::max_align_t).
+   */
+  void* allocate(const size_t size, const size_t align = alignof(std::max_align_t)) {
+    size_t offset = (this->used + align - 1) & ~(align - 1);
+    if (this->blocks.empty() || offset + size > this->blocks.back().size) {
+      // Blocks come from malloc, aligned for anything.
+      addBlock(size);
+      offset = 0;
+    }
+
+    this->total += offset + size - this->used;
+    this->used = offset + size;
+    this->stats.allocations++;
+    this->stats.bytes += size;
+    return (this->blocks.back().data + offset);
+  }
+
+  /**
+   * Frees everything allocated so far. Destructors are not run.
+   */
+  void reset() {
+    if (this->blocks.size() > 1) {
+      size_t size = 0;
+      for (Block& block : this->blocks) {
+        size += block.size;
+        free(block.data);
+      }
+      this->blocks.clear();
+      addBlock(size);
+    }
+    this->used = 0;
+    this->total = 0;
+    this->stats.resets++;
+  }
+
+  size_t getUsed() const {
+    return (this->total);
+  }
+
+  size_t getCapacity() const {
+    size_t size = 0;
+    for (const Block& block : this->blocks)
+      size += block.size;
+    return (size);
+  }
+
+  const Stats& getStats() const {
+    return (this->stats);
+  }
+
+private:
+  void addBlock(const size_t minSize) {
+    size_t size = (minSize > this->blockSize) ? minSize : this->blockSize;
+    char* data = static_cast<char*>(malloc(size));
+    if (data == nullptr) throw std::bad_alloc();
+    this->blocks.push_back(Block { data, size });
+    this->used = 0;
+    this->stats.blocks++;
+  }
+};
+
+/**
+ * A standard allocator handing out arena memory. deallocate() is a no-op, the memory comes back
+ * when the arena is reset.
+ */
+template<typename T>
+class ArenaAllocator {
+
+public:
+  typedef T value_type;
+  Arena* arena;
+
+public:
+  explicit ArenaAllocator(Arena& arena) :
+      arena(&arena) {
+  }
+
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) :
+      arena(other.arena) {
+  }
+
+  T* allocate(const size_t n) {
+    return (static_cast<T*>(this->arena->allocate(n * sizeof(T), alignof(T))));
+  }
+
+  void deallocate(T*, size_t) {
+  }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return (this->arena == other.arena);
+  }
+
+  template<typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const {
+    return (this->arena != other.arena);
+  }
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} /* namespace smlnd */
+
+#endif /* SMLND_ARENA_HPP_ */
@@ -0,0 +1,178 @@
+/*
+ * smlnd_trace.hpp
+ *
+ *  Created on: 16 Oct 2026
+ *      Author: steve
+ */
+
+/*************************************************************************
+ * Doxygen documentation
+ *************************************************************************/
+
+/*! @file smlnd_trace.hpp
+ *  @brief Summerland header for timeline tracing macros.
+ *
+ */
+/*! @defgroup smlnd_tracing
+ *  Scoped trace markers, recorded per thread and written out as Chrome trace_event JSON that loads
+ *  in Perfetto or chrome://tracing.
+ *
+ *  Tracing is compiled in only when SMLND_TRACE is defined, otherwise every macro expands to nothing.
+ *
+ *  SMLND_TRACE_SCOPE("name")   times the enclosing scope, name must be a string literal.
+ *  SMLND_TRACE_THREAD("name")  names the calling thread in the timeline.
+ *  SMLND_TRACE_DUMP(file)      writes everything recorded so far, call once the traced threads are done.
+ */
+
+
+#ifndef SMLND_TRACE_HPP_
+#define SMLND_TRACE_HPP_
+
+#ifdef SMLND_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace smlnd {
+
+/**
+ * One complete ("X") trace event, times in nanoseconds since the trace epoch.
+ */
+struct TraceEvent {
+  const char* name;
+  int64_t start;
+  int64_t duration;
+};
+
+/**
+ * The events of one thread. Only the owning thread writes, it publishes each event by storing the
+ * new count with release order, so a dump can read the buffer without locking. Full buffers drop
+ * further events rather than growing.
+ */
+struct TraceBuffer {
+  static const uint32_t capacity = 1 << 18;
+  std::unique_ptr<TraceEvent[]> events { new TraceEvent[capacity] };
+  std::atomic<uint32_t> count { 0 };
+  uint32_t dropped = 0;
+  int tid = 0;
+  const char* threadName = nullptr;
+};
+
+/**
+ * All thread buffers. The mutex is only taken when a thread records its first event and when dumping.
+ */
+struct TraceRegistry {
+  std::mutex lock;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+  std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+inline TraceRegistry& traceRegistry() {
+  static TraceRegistry registry;
+  return (registry);
+}
+
+inline int64_t traceNow() {
+  return (std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - traceRegistry().epoch).count());
+}
+
+inline TraceBuffer* traceThreadBuffer() {
+  static thread_local TraceBuffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    TraceRegistry& registry = traceRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    registry.buffers.emplace_back(new TraceBuffer());
+    buffer = registry.buffers.back().get();
+    buffer->tid = static_cast<int>(registry.buffers.size());
+  }
+  return (buffer);
+}
+
+inline void traceThreadName(const char* name) {
+  traceThreadBuffer()->threadName = name;
+}
+
+inline void traceRecord(const char* name, const int64_t start, const int64_t end) {
+  TraceBuffer* buffer = traceThreadBuffer();
+  uint32_t n = buffer->count.load(std::memory_order_relaxed);
+  if (n == TraceBuffer::capacity) {
+    buffer->dropped++;
+    return;
+  }
+  buffer->events[n] = TraceEvent { name, start, end - start };
+  buffer->count.store(n + 1, std::memory_order_release);
+}
+
+/**
+ * Writes every thread's events as a trace_event JSON array. Returns false if the file can't be written.
+ */
+inline bool traceDump(const std::string& fileName) {
+  FILE* file = fopen(fileName.c_str(), "w");
+  if (file == nullptr) return (false);
+
+  TraceRegistry& registry = traceRegistry();
+  std::lock_guard<std::mutex> guard(registry.lock);
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  for (auto& buffer : registry.buffers) {
+    if (buffer->threadName != nullptr) {
+      fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+          first ? "" : ",\n", buffer->tid, buffer->threadName);
+      first = false;
+    }
+    uint32_t n = buffer->count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < n; i++) {
+      const TraceEvent& e = buffer->events[i];
+      fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+          first ? "" : ",\n", e.name, buffer->tid, e.start / 1000.0, e.duration / 1000.0);
+      first = false;
+    }
+    if (buffer->dropped > 0) {
+      fprintf(stderr, "trace: thread %d dropped %u events, buffer full\n", buffer->tid, buffer->dropped);
+    }
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  return (fclose(file) == 0);
+}
+
+/**
+ * Records the lifetime of the scope it is declared in.
+ */
+class TraceScope {
+private:
+  const char* name;
+  int64_t start;
+
+public:
+  explicit TraceScope(const char* name) :
+      name(name), start(traceNow()) {
+  }
+  ~TraceScope() {
+    traceRecord(this->name, this->start, traceNow());
+  }
+};
+
+} /* namespace smlnd */
+
+#define SMLND_TRACE_CAT2(A,B) A##B
+#define SMLND_TRACE_CAT(A,B) SMLND_TRACE_CAT2(A,B)
+#define SMLND_TRACE_SCOPE(NAME) smlnd::TraceScope SMLND_TRACE_CAT(smlnd_trace_scope_, __LINE__)(NAME)
+#define SMLND_TRACE_THREAD(NAME) smlnd::traceThreadName(NAME)
+#define SMLND_TRACE_DUMP(FILE) smlnd::traceDump(FILE)
+
+#else
+
+#define SMLND_TRACE_SCOPE(NAME)
+#define SMLND_TRACE_THREAD(NAME)
+#define SMLND_TRACE_DUMP(FILE)
+
+#endif /* SMLND_TRACE */
+
+#endif /* SMLND_TRACE_HPP_ */